@@ -32,6 +32,15 @@ namespace nl = nlohmann;
 
 namespace xpyt
 {
+    class xcompletion_cache;
+    class xinspect_cache;
+    class xmemory_profiler;
+    class xmemory_reclaimer;
+    class xmodule_index;
+    class xname_completer;
+    class xpreimporter;
+    class xwatchdog;
+
     class XEUS_PYTHON_API interpreter : public xeus::xinterpreter
     {
     public:
@@ -79,6 +88,12 @@ namespace xpyt
         py::object m_displayhook;
         py::object m_logger;
         py::object m_terminal_stream;
+        py::object m_completer;
+
+        std::unique_ptr<xcompletion_cache> p_completion_cache;
+        std::unique_ptr<xinspect_cache> p_inspect_cache;
+        std::unique_ptr<xmemory_profiler> p_memory_profiler;
+        std::unique_ptr<xname_completer> p_name_completer;
 
         // The interpreter has the same scope as a `gil_scoped_release` instance
         // so that the GIL is not held by default, it will only be held when the
@@ -94,6 +109,13 @@ namespace xpyt
         bool m_release_gil_at_startup = true;
         gil_scoped_release_ptr m_release_gil = nullptr;
 
+        // Background workers of the cell executions, declared after
+        // m_release_gil so that they are destroyed with the GIL released.
+        std::unique_ptr<xwatchdog> p_watchdog;
+        std::unique_ptr<xmemory_reclaimer> p_memory_reclaimer;
+        std::unique_ptr<xpreimporter> p_preimporter;
+        std::unique_ptr<xmodule_index> p_module_index;
+
         bool m_redirect_display_enabled;
     };
 }
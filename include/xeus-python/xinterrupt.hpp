@@ -0,0 +1,54 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_INTERRUPT_HPP
+#define XPYT_INTERRUPT_HPP
+
+#include "xeus_python_config.hpp"
+
+namespace xpyt
+{
+    /**
+     * Scope guard registering the calling thread as the thread executing
+     * user code, so that it can be interrupted by interrupt_execution().
+     * An interrupt that is still pending when the scope ends is discarded.
+     * It must be instantiated with the GIL held.
+     */
+    class XEUS_PYTHON_API execution_scope
+    {
+    public:
+
+        execution_scope();
+        ~execution_scope();
+
+        execution_scope(const execution_scope&) = delete;
+        execution_scope& operator=(const execution_scope&) = delete;
+    };
+
+    /**
+     * Raises a KeyboardInterrupt in the code currently executed, if any.
+     * This does not rely on the delivery of SIGINT to the process and can be
+     * called from any thread, without holding the GIL.
+     */
+    XEUS_PYTHON_API void interrupt_execution();
+
+    /**
+     * Replaces the SIGINT handler of the interpreter, so that the interrupt
+     * requests of the frontend (SIGINT sent to the kernel) go through
+     * interrupt_execution(): they are only delivered while a cell is
+     * executed, and also reach cells executed by other threads than the main
+     * thread. A handler installed with signal.signal by the user code takes
+     * precedence. Must be called after the initialization of the interpreter.
+     * No-op on Windows.
+     */
+    XEUS_PYTHON_API void install_interrupt_handler();
+}
+
+#endif
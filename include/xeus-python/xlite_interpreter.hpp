@@ -0,0 +1,96 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_LITE_INTERPRETER_HPP
+#define XPYT_LITE_INTERPRETER_HPP
+
+#ifdef __GNUC__
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wattributes"
+#endif
+
+#include <memory>
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+#include "xeus/xinterpreter.hpp"
+
+#include "pybind11/pybind11.h"
+
+#include "xeus_python_config.hpp"
+
+namespace py = pybind11;
+namespace nl = nlohmann;
+
+namespace xpyt
+{
+    /**
+     * Interpreter executing the cells without IPython: cells are compiled and
+     * executed in the namespace of a bare __main__ module, the value of the
+     * last expression is published by a native display hook and errors go
+     * through the native traceback formatting. There is no magics, history,
+     * output cache nor debugger, in exchange for a faster startup and a
+     * smaller memory footprint.
+     */
+    class XEUS_PYTHON_API lite_interpreter : public xeus::xinterpreter
+    {
+    public:
+
+        using gil_scoped_release_ptr = std::unique_ptr<py::gil_scoped_release>;
+
+        lite_interpreter();
+        virtual ~lite_interpreter();
+
+    protected:
+
+        void configure_impl() override;
+
+        nl::json execute_request_impl(int execution_counter,
+                                      const std::string& code,
+                                      bool silent,
+                                      bool store_history,
+                                      nl::json user_expressions,
+                                      bool allow_stdin) override;
+
+        nl::json complete_request_impl(const std::string& code, int cursor_pos) override;
+
+        nl::json inspect_request_impl(const std::string& code,
+                                      int cursor_pos,
+                                      int detail_level) override;
+
+        nl::json is_complete_request_impl(const std::string& code) override;
+
+        nl::json kernel_info_request_impl() override;
+
+        void shutdown_request_impl() override;
+
+        nl::json internal_request_impl(const nl::json& content) override;
+
+        void display_result(const py::object& value);
+
+        py::object m_shell;
+
+        // Execution count and silent flag of the cell being executed,
+        // used by the display hook
+        int m_execution_count = 0;
+        bool m_silent = false;
+
+        // Same as interpreter::m_release_gil
+        bool m_release_gil_at_startup = true;
+        gil_scoped_release_ptr m_release_gil = nullptr;
+    };
+}
+
+#ifdef __GNUC__
+    #pragma GCC diagnostic pop
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_METRICS_HPP
+#define XPYT_METRICS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "xeus_python_config.hpp"
+
+namespace xpyt
+{
+    // Metrics are identified by their name and their labels, given
+    // in the Prometheus syntax, e.g. add_counter("requests_total", "type=\"execute\"").
+    // All the metric names are prefixed with "xpython_" in the exposition.
+    XEUS_PYTHON_API void add_counter(const std::string& name, const std::string& labels, double value = 1.);
+    XEUS_PYTHON_API void set_gauge(const std::string& name, const std::string& labels, double value);
+
+    // Collectors are called before each exposition of the metrics, so that
+    // values maintained outside of the kernel (e.g. allocator statistics)
+    // can be updated lazily with set_gauge.
+    XEUS_PYTHON_API void register_metrics_collector(std::function<void()> collector);
+
+    // Returns the metrics in the Prometheus text exposition format
+    XEUS_PYTHON_API std::string format_metrics();
+
+    /**
+     * Periodically writes the metrics to a file, and / or serves them on a
+     * Unix domain socket. The file is replaced atomically, so that it can be
+     * read by the textfile collector of the node exporter. Clients connecting
+     * to the socket receive an HTTP response, e.g.:
+     *
+     *     curl --unix-socket /path/to/socket http://localhost/metrics
+     */
+    class XEUS_PYTHON_API xmetrics_exporter
+    {
+    public:
+
+        xmetrics_exporter(const std::string& file_path,
+                          const std::string& socket_path,
+                          double interval = 10.);
+        ~xmetrics_exporter();
+
+        xmetrics_exporter(const xmetrics_exporter&) = delete;
+        xmetrics_exporter& operator=(const xmetrics_exporter&) = delete;
+
+    private:
+
+        void write_file();
+        void run_file_writer();
+        void run_socket_server();
+
+        std::string m_file_path;
+        std::string m_socket_path;
+        double m_interval;
+
+        std::atomic<bool> m_stopped;
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::thread m_file_writer;
+        std::thread m_socket_server;
+    };
+}
+
+#endif
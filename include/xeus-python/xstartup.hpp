@@ -0,0 +1,54 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_STARTUP_HPP
+#define XPYT_STARTUP_HPP
+
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+#include "xeus_python_config.hpp"
+
+namespace nl = nlohmann;
+
+namespace xpyt
+{
+    // Records the time elapsed since the first recorded event, which
+    // should be recorded as early as possible in main. When a report path
+    // is set and the function is called with the GIL held, the modules
+    // imported since the previous event are recorded in the "imports"
+    // section of the report.
+    XEUS_PYTHON_API void mark_startup_event(const std::string& name);
+
+    // Time elapsed since the first recorded event in seconds
+    XEUS_PYTHON_API double get_startup_elapsed();
+
+    // Adds a section to the startup report, e.g. the imported modules
+    XEUS_PYTHON_API void set_startup_info(const std::string& key, const nl::json& value);
+
+    // Appends an entry to an array section of the startup report
+    XEUS_PYTHON_API void append_startup_info(const std::string& key, const nl::json& value);
+
+    // Returns the startup report:
+    // {"start_time": <unix time>, "events": [{"name": ..., "time": ...}, ...], <sections>...}
+    XEUS_PYTHON_API nl::json get_startup_report();
+
+    // Sets the file the report is written to, "-" standing for stderr.
+    // The report is not written if no path is set.
+    XEUS_PYTHON_API void set_startup_report_path(const std::string& path);
+
+    // Writes the report, it is written again by subsequent calls
+    // as it is completed by the background tasks started once
+    // the kernel is ready.
+    XEUS_PYTHON_API void write_startup_report();
+}
+
+#endif
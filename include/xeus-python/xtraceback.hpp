@@ -11,6 +11,7 @@
 #ifndef XPYT_TRACEBACK_HPP
 #define XPYT_TRACEBACK_HPP
 
+#include <cstddef>
 #include <vector>
 #include <string>
 
@@ -29,6 +30,17 @@ namespace xpyt
         std::vector<std::string> m_traceback;
     };
 
+    // A null limit means no limit
+    struct XEUS_PYTHON_API xtraceback_limits
+    {
+        // Maximum number of displayed frames, repeated frames being
+        // collapsed first
+        std::size_t m_max_frames = 0;
+        // Maximum number of characters of the source lines and of the lines
+        // of the error value
+        std::size_t m_max_line_length = 0;
+    };
+
     XEUS_PYTHON_API py::module get_traceback_module();
 
     XEUS_PYTHON_API void register_filename_mapping(const std::string& filename, int execution_count);
@@ -38,6 +50,15 @@ namespace xpyt
 
     XEUS_PYTHON_API XPYT_FORCE_PYBIND11_EXPORT
     xerror extract_error(const py::object& type, const py::object& value, const py::object& traceback);
+
+    XEUS_PYTHON_API XPYT_FORCE_PYBIND11_EXPORT
+    xerror extract_error(py::error_already_set& error, const xtraceback_limits& limits);
+
+    XEUS_PYTHON_API XPYT_FORCE_PYBIND11_EXPORT
+    xerror extract_error(const py::object& type,
+                         const py::object& value,
+                         const py::object& traceback,
+                         const xtraceback_limits& limits);
 }
 
 #endif
@@ -8,10 +8,15 @@
 * The full license is in the file LICENSE, distributed with this software. *
 ****************************************************************************/
 
+#include <cerrno>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #ifdef __GNUC__
 #include <stdio.h>
@@ -29,10 +34,17 @@
 #include "pybind11/pybind11.h"
 
 #include "xeus-python/xinterpreter.hpp"
+#include "xeus-python/xinterrupt.hpp"
 #include "xeus-python/xdebugger.hpp"
+#include "xeus-python/xlite_interpreter.hpp"
+#include "xeus-python/xmetrics.hpp"
 #include "xeus-python/xpaths.hpp"
+#include "xeus-python/xstartup.hpp"
 #include "xeus-python/xeus_python_config.hpp"
 
+#include "xallocator.hpp"
+#include "xzygote.hpp"
+
 #ifdef __GNUC__
 void handler(int sig)
 {
@@ -81,6 +93,84 @@ std::string extract_filename(int argc, char* argv[])
     return res;
 }
 
+// Extracts the value of the "--name value" option and
+// removes it from argv so that IPython does not see it.
+std::string extract_option(int& argc, char* argv[], const std::string& name)
+{
+    std::string res = "";
+    for (int i = 0; i < argc; ++i)
+    {
+        if ((std::string(argv[i]) == name) && (i + 1 < argc))
+        {
+            res = argv[i + 1];
+            for (int j = i; j < argc - 2; ++j)
+            {
+                argv[j] = argv[j + 2];
+            }
+            argc -= 2;
+            break;
+        }
+    }
+    return res;
+}
+
+// Removes the "--name" flag from argv, returns whether it was present
+bool extract_flag(int& argc, char* argv[], const std::string& name)
+{
+    for (int i = 0; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == name)
+        {
+            for (int j = i; j < argc - 1; ++j)
+            {
+                argv[j] = argv[j + 1];
+            }
+            argc -= 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> res;
+    std::istringstream iss(list);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        if (!item.empty())
+        {
+            res.push_back(item);
+        }
+    }
+    return res;
+}
+
+// Parses a strictly positive number of seconds, returns false for any
+// other value
+bool parse_interval(const std::string& value, double& interval)
+{
+    const char* begin = value.c_str();
+    char* end = nullptr;
+    errno = 0;
+    interval = std::strtod(begin, &end);
+    return end != begin && *end == '\0' && errno == 0
+        && std::isfinite(interval) && interval > 0.;
+}
+
+// Replaces the {pid} placeholders of the path with the pid of the process
+std::string substitute_pid(std::string path)
+{
+    const std::string placeholder = "{pid}";
+    const std::string pid = std::to_string(::getpid());
+    for (std::size_t pos = path.find(placeholder); pos != std::string::npos; pos = path.find(placeholder, pos + pid.size()))
+    {
+        path.replace(pos, placeholder.size(), pid);
+    }
+    return path;
+}
+
 void print_pythonhome()
 {
     std::setlocale(LC_ALL, "en_US.utf8");
@@ -94,6 +184,8 @@ void print_pythonhome()
 
 int main(int argc, char* argv[])
 {
+    xpyt::mark_startup_event("main");
+
     if (should_print_version(argc, argv))
     {
         std::clog << "xpython " << XPYT_VERSION << std::endl;
@@ -110,6 +202,52 @@ int main(int argc, char* argv[])
         std::clog.setstate(std::ios_base::failbit);
     }
 
+    // Client of a zygote, standing for the kernel forked by the zygote
+    std::string zygote_connect = extract_option(argc, argv, "--zygote-connect");
+    if (!zygote_connect.empty())
+    {
+        return xpyt::connect_zygote(zygote_connect, extract_filename(argc, argv));
+    }
+
+    std::string zygote_socket = extract_option(argc, argv, "--zygote");
+    std::string zygote_preload = extract_option(argc, argv, "--zygote-preload");
+
+    // Selecting the allocator of the Python memory manager, this must be done
+    // before any memory is allocated by Python
+    std::string allocator = extract_option(argc, argv, "--allocator");
+    if (!xpyt::set_python_allocator(allocator))
+    {
+        std::clog << "Allocator " << allocator << " is not available, using the default allocator" << std::endl;
+        xpyt::set_python_allocator("default");
+    }
+
+    // Minimal shell executing the cells without IPython
+    bool lite = extract_flag(argc, argv, "--lite");
+
+    std::string metrics_file = extract_option(argc, argv, "--metrics-file");
+    std::string metrics_socket = extract_option(argc, argv, "--metrics-socket");
+    std::string metrics_interval = extract_option(argc, argv, "--metrics-interval");
+    double interval = 10.;
+    if (!metrics_interval.empty() && !parse_interval(metrics_interval, interval))
+    {
+        std::cerr << "Invalid --metrics-interval " << metrics_interval
+                  << ", expected a positive number of seconds" << std::endl;
+        return 1;
+    }
+    // The kernels forked by a zygote would share the same file or socket
+    for (const std::string* path : {&metrics_file, &metrics_socket})
+    {
+        if (!zygote_socket.empty() && !path->empty() && path->find("{pid}") == std::string::npos)
+        {
+            std::cerr << "The metrics paths given with --zygote must contain {pid}, e.g. "
+                      << "--metrics-file /var/lib/xpython/metrics-{pid}.prom" << std::endl;
+            return 1;
+        }
+    }
+
+    // Writes the timestamps of the startup steps upon the first kernel_info_reply
+    xpyt::set_startup_report_path(extract_option(argc, argv, "--startup-report"));
+
     // Registering SIGSEGV handler
 #ifdef __GNUC__
     std::clog << "registering handler for SIGSEGV" << std::endl;
@@ -129,9 +267,11 @@ int main(int argc, char* argv[])
     // Setting PYTHONHOME
     xpyt::set_pythonhome();
     print_pythonhome();
+    xpyt::mark_startup_event("pythonhome");
 
     // Instanciating the Python interpreter
     py::scoped_interpreter guard;
+    xpyt::mark_startup_event("py_initialize");
 
     // Setting argv
     wchar_t** argw = new wchar_t*[size_t(argc)];
@@ -145,16 +285,50 @@ int main(int argc, char* argv[])
         PyMem_RawFree(argw[i]);
     }
     delete[] argw;
+    xpyt::mark_startup_event("sys_argv");
 
     // Instantiating the xeus xinterpreter
-    using interpreter_ptr = std::unique_ptr<xpyt::interpreter>;
-    interpreter_ptr interpreter = interpreter_ptr(new xpyt::interpreter());
+    using interpreter_ptr = std::unique_ptr<xeus::xinterpreter>;
+    interpreter_ptr interpreter = lite ? interpreter_ptr(new xpyt::lite_interpreter())
+                                       : interpreter_ptr(new xpyt::interpreter());
+    xpyt::mark_startup_event("interpreter");
+
+    std::string connection_filename;
+    if (!zygote_socket.empty())
+    {
+        // The interpreter is configured once in the zygote, the kernel
+        // does not configure it again when it starts.
+        xpyt::detach_kernel();
+        interpreter->configure();
+        connection_filename = xpyt::run_zygote(zygote_socket, split_list(zygote_preload));
+        if (connection_filename.empty())
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        connection_filename = extract_filename(argc, argv);
+    }
+
+    // Interrupt requests only interrupt the execution of cells. The thread
+    // handling them is started after the fork of the zygote.
+    xpyt::install_interrupt_handler();
+
+    // Exporting metrics, the exporter threads run until the kernel stops.
+    // They are started after the fork of the zygote since threads do not
+    // survive it.
+    std::unique_ptr<xpyt::xmetrics_exporter> metrics_exporter;
+    if (!metrics_file.empty() || !metrics_socket.empty())
+    {
+        metrics_exporter.reset(new xpyt::xmetrics_exporter(substitute_pid(metrics_file),
+                                                           substitute_pid(metrics_socket),
+                                                           interval));
+    }
 
     using history_manager_ptr = std::unique_ptr<xeus::xhistory_manager>;
     history_manager_ptr hist = xeus::make_in_memory_history_manager();
 
-    std::string connection_filename = extract_filename(argc, argv);
-
 #ifdef XEUS_PYTHON_PYPI_WARNING
     std::clog <<
         "WARNING: this instance of xeus-python has been installed from a PyPI wheel.\n"
@@ -162,6 +336,8 @@ int main(int argc, char* argv[])
         << std::endl;
 #endif
 
+    // The debugger relies on IPython to run the cells
+    auto make_debugger = lite ? &xeus::make_null_debugger : &xpyt::make_python_debugger;
     nl::json debugger_config;
     debugger_config["python"] = executable;
 
@@ -176,8 +352,9 @@ int main(int argc, char* argv[])
                              xeus::make_console_logger(xeus::xlogger::msg_type,
                                                        xeus::make_file_logger(xeus::xlogger::content, "xeus.log")),
                              xeus::make_xserver_shell_main,
-                             xpyt::make_python_debugger,
+                             make_debugger,
                              debugger_config);
+        xpyt::attach_kernel();
 
         std::clog <<
             "Starting xeus-python kernel...\n\n"
@@ -185,6 +362,7 @@ int main(int argc, char* argv[])
             " the " + connection_filename + " file."
             << std::endl;
 
+        xpyt::mark_startup_event("kernel");
         kernel.start();
     }
     else
@@ -194,7 +372,7 @@ int main(int argc, char* argv[])
                              std::move(hist),
                              nullptr,
                              xeus::make_xserver_shell_main,
-                             xpyt::make_python_debugger,
+                             make_debugger,
                              debugger_config);
 
         const auto& config = kernel.get_config();
@@ -216,6 +394,7 @@ int main(int argc, char* argv[])
             "}\n```"
             << std::endl;
 
+        xpyt::mark_startup_event("kernel");
         kernel.start();
     }
 
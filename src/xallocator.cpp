@@ -0,0 +1,95 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+
+#include "Python.h"
+
+#ifdef XEUS_PYTHON_USE_MIMALLOC
+#include "mimalloc.h"
+#endif
+
+#include "xeus-python/xmetrics.hpp"
+
+#include "xallocator.hpp"
+
+namespace xpyt
+{
+#ifdef XEUS_PYTHON_USE_MIMALLOC
+    namespace
+    {
+        void* mimalloc_malloc(void* /*ctx*/, std::size_t size)
+        {
+            return mi_malloc(size);
+        }
+
+        void* mimalloc_calloc(void* /*ctx*/, std::size_t nelem, std::size_t elsize)
+        {
+            return mi_calloc(nelem, elsize);
+        }
+
+        void* mimalloc_realloc(void* /*ctx*/, void* ptr, std::size_t new_size)
+        {
+            return mi_realloc(ptr, new_size);
+        }
+
+        void mimalloc_free(void* /*ctx*/, void* ptr)
+        {
+            mi_free(ptr);
+        }
+
+        void collect_mimalloc_metrics()
+        {
+            std::size_t elapsed_msecs, user_msecs, system_msecs;
+            std::size_t current_rss, peak_rss, current_commit, peak_commit, page_faults;
+            mi_process_info(&elapsed_msecs, &user_msecs, &system_msecs,
+                            &current_rss, &peak_rss, &current_commit, &peak_commit, &page_faults);
+            set_gauge("allocator_committed_bytes", "allocator=\"mimalloc\"", static_cast<double>(current_commit));
+            set_gauge("allocator_peak_committed_bytes", "allocator=\"mimalloc\"", static_cast<double>(peak_commit));
+            set_gauge("allocator_page_faults", "allocator=\"mimalloc\"", static_cast<double>(page_faults));
+        }
+    }
+#endif
+
+    bool set_python_allocator(const std::string& name)
+    {
+        if (name.empty() || name == "default")
+        {
+            set_gauge("allocator_info", "allocator=\"default\"", 1.);
+            return true;
+        }
+
+#ifdef XEUS_PYTHON_USE_MIMALLOC
+        // PYTHONMALLOC would replace the allocator upon initialization
+        const char* python_malloc = std::getenv("PYTHONMALLOC");
+        if (name == "mimalloc" && (python_malloc == nullptr || *python_malloc == '\0'))
+        {
+            PyMemAllocatorEx allocator = {
+                nullptr,
+                mimalloc_malloc,
+                mimalloc_calloc,
+                mimalloc_realloc,
+                mimalloc_free
+            };
+            PyMem_SetAllocator(PYMEM_DOMAIN_RAW, &allocator);
+            PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &allocator);
+            PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &allocator);
+
+            set_gauge("allocator_info", "allocator=\"mimalloc\"", 1.);
+            register_metrics_collector(collect_mimalloc_metrics);
+            return true;
+        }
+#endif
+
+        return false;
+    }
+}
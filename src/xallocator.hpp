@@ -0,0 +1,31 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_ALLOCATOR_HPP
+#define XPYT_ALLOCATOR_HPP
+
+#include <string>
+
+namespace xpyt
+{
+    /**
+     * Installs the named allocator ("default" or "mimalloc") for the raw,
+     * mem and object domains of the Python memory manager. This must be
+     * done before the interpreter is initialized, so that no memory block
+     * is freed by an allocator that did not allocate it.
+     *
+     * Returns false if the allocator is unknown, was not enabled at
+     * build time (XPYT_USE_MIMALLOC), or if PYTHONMALLOC is set. Statistics of the allocator are
+     * exported with the metrics of the kernel.
+     */
+    bool set_python_allocator(const std::string& name);
+}
+
+#endif
@@ -0,0 +1,193 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "pybind11/pybind11.h"
+
+#include "marshal.h"
+
+#include "xcode_cache.hpp"
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+namespace xpyt
+{
+    std::uint64_t hash_source(const std::string& source)
+    {
+        // FNV-1a
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (char c : source)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    std::string get_cache_dir()
+    {
+#ifdef WIN32
+        const char* base = std::getenv("LOCALAPPDATA");
+        return base != nullptr ? std::string(base) + "\\xeus-python\\cache" : std::string();
+#else
+        const char* base = std::getenv("XDG_CACHE_HOME");
+        if (base != nullptr && *base != '\0')
+        {
+            return std::string(base) + "/xeus-python";
+        }
+        const char* home = std::getenv("HOME");
+        return home != nullptr ? std::string(home) + "/.cache/xeus-python" : std::string();
+#endif
+    }
+
+    namespace
+    {
+        std::string get_code_cache_path(const std::string& name, std::uint64_t hash)
+        {
+            std::string dir = get_cache_dir();
+            if (dir.empty())
+            {
+                return dir;
+            }
+            std::ostringstream oss;
+            oss << dir << '/' << name << '-' << std::hex << hash << '-' << std::dec
+                << PyImport_GetMagicNumber() << ".bin";
+            return oss.str();
+        }
+
+        py::object load_code(const std::string& path)
+        {
+            std::ifstream in(path, std::ios::in | std::ios::binary);
+            if (!in)
+            {
+                return py::object();
+            }
+            std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            PyObject* code = PyMarshal_ReadObjectFromString(data.data(), static_cast<Py_ssize_t>(data.size()));
+            if (code == nullptr || !PyCode_Check(code))
+            {
+                Py_XDECREF(code);
+                PyErr_Clear();
+                return py::object();
+            }
+            return py::reinterpret_steal<py::object>(code);
+        }
+
+        void store_code(const std::string& path, const py::object& code)
+        {
+            py::module sys = py::module::import("sys");
+            if (sys.attr("dont_write_bytecode").cast<bool>())
+            {
+                return;
+            }
+
+            PyObject* data = PyMarshal_WriteObjectToString(code.ptr(), Py_MARSHAL_VERSION);
+            if (data == nullptr)
+            {
+                PyErr_Clear();
+                return;
+            }
+            py::bytes bytes = py::reinterpret_steal<py::bytes>(data);
+
+            try
+            {
+                py::module::import("os").attr("makedirs")(get_cache_dir(), "exist_ok"_a=true);
+            }
+            catch (py::error_already_set&)
+            {
+                return;
+            }
+
+            // Written in a temporary file and renamed, so that concurrent
+            // kernel launches never read a partially written file
+            std::string tmp_path = path + ".tmp" + std::to_string(py::module::import("os").attr("getpid")().cast<long>());
+            {
+                std::ofstream out(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+                std::string content = bytes;
+                out.write(content.data(), static_cast<std::streamsize>(content.size()));
+                if (!out)
+                {
+                    out.close();
+                    std::remove(tmp_path.c_str());
+                    return;
+                }
+            }
+            if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+            {
+                std::remove(tmp_path.c_str());
+            }
+        }
+
+        // Code objects are intentionally leaked, they must outlive
+        // static destructors which run after Py_Finalize.
+        std::map<std::uint64_t, PyObject*>& get_code_map()
+        {
+            static std::map<std::uint64_t, PyObject*>* code_map = new std::map<std::uint64_t, PyObject*>();
+            return *code_map;
+        }
+    }
+
+    py::object compile_cached(const std::string& name, const std::string& source)
+    {
+        std::uint64_t hash = hash_source(source);
+        auto& code_map = get_code_map();
+        auto it = code_map.find(hash);
+        if (it != code_map.end())
+        {
+            return py::reinterpret_borrow<py::object>(it->second);
+        }
+
+        std::string path = get_code_cache_path(name, hash);
+        py::object code = path.empty() ? py::object() : load_code(path);
+        if (!code)
+        {
+            std::string filename = "<xpython-" + name + ">";
+            PyObject* compiled = Py_CompileString(source.c_str(), filename.c_str(), Py_file_input);
+            if (compiled == nullptr)
+            {
+                throw py::error_already_set();
+            }
+            code = py::reinterpret_steal<py::object>(compiled);
+            if (!path.empty())
+            {
+                store_code(path, code);
+            }
+        }
+
+        code_map[hash] = code.inc_ref().ptr();
+        return code;
+    }
+
+    void exec_cached(const std::string& name, const std::string& source, const py::object& scope)
+    {
+        // Workaround for https://github.com/pybind/pybind11/issues/1654
+        if (scope.attr("get")("__builtins__").is_none())
+        {
+            scope["__builtins__"] = py::module::import("builtins");
+        }
+
+        py::object code = compile_cached(name, source);
+        PyObject* res = PyEval_EvalCode(code.ptr(), scope.ptr(), scope.ptr());
+        if (res == nullptr)
+        {
+            throw py::error_already_set();
+        }
+        Py_DECREF(res);
+    }
+}
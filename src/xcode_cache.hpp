@@ -0,0 +1,46 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_CODE_CACHE_HPP
+#define XPYT_CODE_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "pybind11/pybind11.h"
+
+namespace py = pybind11;
+
+namespace xpyt
+{
+    // Directory of the files cached by the kernel, e.g. ~/.cache/xeus-python,
+    // empty if it cannot be determined
+    std::string get_cache_dir();
+
+    // Hash of the content of the cached files, stable across processes
+    std::uint64_t hash_source(const std::string& source);
+
+    /**
+     * Compiles the Python source embedded in the kernel. Code objects are
+     * kept in memory, and marshalled in the user cache directory
+     * (e.g. ~/.cache/xeus-python) under a name made of the given name, a
+     * hash of the source and the magic number of the interpreter, so that
+     * subsequent kernel launches do not parse and compile the source again.
+     * Nothing is written when sys.dont_write_bytecode is set.
+     *
+     * Must be called with the GIL held.
+     */
+    py::object compile_cached(const std::string& name, const std::string& source);
+
+    // Executes the compiled source in the given scope
+    void exec_cached(const std::string& name, const std::string& source, const py::object& scope);
+}
+
+#endif
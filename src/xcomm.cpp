@@ -8,8 +8,10 @@
 * The full license is in the file LICENSE, distributed with this software. *
 ****************************************************************************/
 
+#include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "nlohmann/json.hpp"
 
@@ -22,6 +24,8 @@
 #include "pybind11/functional.h"
 #include "pybind11/eval.h"
 
+#include "xeus-python/xmetrics.hpp"
+#include "xeus-python/xstartup.hpp"
 #include "xeus-python/xutils.hpp"
 
 #include "xcomm.hpp"
@@ -73,6 +77,19 @@ namespace xpyt
         void register_target(const py::str& target_name, const py::object& callback);
     };
 
+    namespace
+    {
+        using deferred_target_list = std::vector<std::pair<std::string, py::object>>;
+
+        // Intentionally leaked, Python objects must not be released by
+        // static destructors which run after Py_Finalize.
+        deferred_target_list& get_deferred_targets()
+        {
+            static deferred_target_list* targets = new deferred_target_list();
+            return *targets;
+        }
+    }
+
     /************************
      * xcomm implementation *
      ************************/
@@ -117,6 +134,8 @@ namespace xpyt
 
     void xcomm::send(const py::args& /*args*/, const py::kwargs& kwargs)
     {
+        add_counter("comm_messages_total", "direction=\"sent\"");
+        add_counter("iopub_messages_total", "type=\"comm_msg\"");
         m_comm.send(
             kwargs.attr("get")("metadata", py::dict()),
             kwargs.attr("get")("data", py::dict()),
@@ -136,6 +155,10 @@ namespace xpyt
 
     xeus::xtarget* xcomm::target(const py::kwargs& kwargs) const
     {
+        if (!is_kernel_available())
+        {
+            throw std::runtime_error("Comms cannot be opened before the kernel is started");
+        }
         std::string target_name = kwargs["target_name"].cast<std::string>();
         return xeus::get_interpreter().comm_manager().target(target_name);
     }
@@ -156,12 +179,21 @@ namespace xpyt
     auto xcomm::cpp_callback(const python_callback_type& py_callback) const -> cpp_callback_type
     {
         return [this, py_callback](const xeus::xmessage& msg) {
+            add_counter("comm_messages_total", "direction=\"received\"");
             XPYT_HOLDING_GIL(py_callback(cppmessage_to_pymessage(msg)))
         };
     }
 
     void xcomm_manager::register_target(const py::str& target_name, const py::object& callback)
     {
+        // E.g. modules preloaded by the zygote, the target is registered in
+        // the kernel of each forked child
+        if (!is_kernel_available())
+        {
+            get_deferred_targets().emplace_back(static_cast<std::string>(target_name), callback);
+            return;
+        }
+
         auto target_callback = [&callback] (xeus::xcomm&& comm, const xeus::xmessage& msg) {
             XPYT_HOLDING_GIL(callback(xcomm(std::move(comm)), cppmessage_to_pymessage(msg)));
         };
@@ -171,6 +203,17 @@ namespace xpyt
         );
     }
 
+    void register_deferred_comm_targets()
+    {
+        // The callbacks are referenced by the registered targets, the list
+        // is kept, and no target is deferred once the kernel is available
+        xcomm_manager manager;
+        for (const auto& target : get_deferred_targets())
+        {
+            manager.register_target(py::str(target.first), target.second);
+        }
+    }
+
     /***************
      * comm module *
      ***************/
@@ -192,6 +235,8 @@ namespace xpyt
             .def(py::init<>())
             .def("register_target", &xcomm_manager::register_target);
 
+        mark_startup_event("comm_module");
+
         return comm_module;
     }
 
@@ -18,6 +18,10 @@ namespace py = pybind11;
 namespace xpyt
 {
     py::module get_comm_module();
+
+    // Registers the comm targets registered before the kernel existed, must
+    // be called with the GIL held once the comm manager of the kernel is set
+    void register_deferred_comm_targets();
 }
 
 #endif
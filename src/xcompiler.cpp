@@ -20,8 +20,10 @@
 #include "pybind11/pybind11.h"
 #include "pybind11/functional.h"
 
+#include "xeus-python/xstartup.hpp"
 #include "xeus-python/xutils.hpp"
 
+#include "xcode_cache.hpp"
 #include "xcompiler.hpp"
 #include "xinternal_utils.hpp"
 
@@ -46,7 +48,7 @@ namespace xpyt
 
         compiler_module.def("get_filename", get_filename);
 
-        ::xpyt::exec(py::str(R"(
+        exec_cached("compiler_module", R"(
 from IPython.core.compilerop import CachingCompiler
 
 class XCachingCompiler(CachingCompiler):
@@ -62,7 +64,9 @@ class XCachingCompiler(CachingCompiler):
             self.filename_mapper(filename, number)
 
         return filename
-         )"), compiler_module.attr("__dict__"));
+         )", compiler_module.attr("__dict__"));
+
+        mark_startup_event("compiler_module");
 
         return compiler_module;
     }
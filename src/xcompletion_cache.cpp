@@ -0,0 +1,141 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "xcompletion_cache.hpp"
+#include "xinternal_utils.hpp"
+
+namespace xpyt
+{
+    /************************************
+     * xcompletion_cache implementation *
+     ************************************/
+
+    xcompletion_cache::xcompletion_cache()
+        : m_valid(false)
+        , m_complete(false)
+        , m_cursor_pos(0)
+        , m_cursor_start(0)
+    {
+    }
+
+    bool xcompletion_cache::lookup(const std::string& code,
+                                   int cursor_pos,
+                                   std::vector<std::string>& matches,
+                                   int& cursor_start)
+    {
+        if (!m_valid || cursor_pos < m_cursor_pos)
+        {
+            return false;
+        }
+
+        std::size_t cached_cursor = utf8_offset(m_code, m_cursor_pos);
+        std::size_t cursor = utf8_offset(code, cursor_pos);
+        std::size_t start = utf8_offset(code, m_cursor_start);
+        if (cached_cursor == std::string::npos || cursor == std::string::npos || start == std::string::npos
+            || cursor < cached_cursor)
+        {
+            return false;
+        }
+
+        // Same code before the cached cursor and after the cursor
+        if (code.compare(0, cached_cursor, m_code, 0, cached_cursor) != 0
+            || code.compare(cursor, std::string::npos, m_code, cached_cursor, std::string::npos) != 0)
+        {
+            return false;
+        }
+
+        if (cursor == cached_cursor)
+        {
+            matches = m_matches;
+            cursor_start = m_cursor_start;
+            return true;
+        }
+
+        // Only the token being completed has grown
+        if (!m_complete)
+        {
+            return false;
+        }
+        for (std::size_t i = cached_cursor; i < cursor; ++i)
+        {
+            if (!is_identifier_char(code[i]))
+            {
+                return false;
+            }
+        }
+
+        const std::string token = code.substr(start, cursor - start);
+        // The private names are omitted from the matches of an empty token
+        if (start == cached_cursor && token[0] == '_')
+        {
+            return false;
+        }
+
+        // Matches are narrowed like the matchers of IPython do, magics being
+        // matched without their escape. The matches that do not extend the
+        // cached token, e.g. case-insensitive matches of jedi, cannot be
+        // narrowed without running the completer again.
+        const std::string cached_token = code.substr(start, cached_cursor - start);
+        std::vector<std::string> narrowed;
+        for (const auto& match : m_matches)
+        {
+            std::size_t escape = 0;
+            while (escape < 2 && escape < match.size() && match[escape] == '%')
+            {
+                ++escape;
+            }
+            if (match.compare(escape, cached_token.size(), cached_token) != 0)
+            {
+                return false;
+            }
+            if (match.compare(escape, token.size(), token) == 0)
+            {
+                narrowed.push_back(match);
+            }
+        }
+
+        // Subsequent requests are narrowed from the new match set
+        m_code = code;
+        m_cursor_pos = cursor_pos;
+        m_matches = narrowed;
+
+        matches = std::move(narrowed);
+        cursor_start = m_cursor_start;
+        return true;
+    }
+
+    void xcompletion_cache::store(const std::string& code,
+                                  int cursor_pos,
+                                  int cursor_start,
+                                  int cursor_end,
+                                  const std::vector<std::string>& matches,
+                                  bool complete)
+    {
+        // Matches replacing code after the cursor cannot be narrowed
+        // when the token grows
+        m_valid = cursor_end == cursor_pos && cursor_start <= cursor_pos;
+        m_complete = complete;
+        m_code = code;
+        m_cursor_pos = cursor_pos;
+        m_cursor_start = cursor_start;
+        m_matches = matches;
+    }
+
+    void xcompletion_cache::clear()
+    {
+        m_valid = false;
+        m_code.clear();
+        m_matches.clear();
+    }
+}
@@ -0,0 +1,69 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_COMPLETION_CACHE_HPP
+#define XPYT_COMPLETION_CACHE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace xpyt
+{
+    /**
+     * Keeps the matches of the last completion, so that the completions
+     * requested while the user keeps typing the same token (df.co, df.col,
+     * df.colu...) are obtained by filtering them instead of running the
+     * completer again.
+     *
+     * A request is served from the cache when the code before the cached
+     * cursor and the code after the cursor are unchanged, and only
+     * identifier characters were inserted at the cursor. The cache must be
+     * cleared whenever the namespace of the user may have changed.
+     *
+     * Cursor positions are expressed in unicode code points, as in the
+     * messaging protocol.
+     */
+    class xcompletion_cache
+    {
+    public:
+
+        xcompletion_cache();
+
+        // Fills the matches and the cursor start of the request and returns
+        // true if they can be obtained from the cached matches.
+        bool lookup(const std::string& code,
+                    int cursor_pos,
+                    std::vector<std::string>& matches,
+                    int& cursor_start);
+
+        // Matches that may have been truncated by the completer can be
+        // returned for the same request but cannot be narrowed.
+        void store(const std::string& code,
+                   int cursor_pos,
+                   int cursor_start,
+                   int cursor_end,
+                   const std::vector<std::string>& matches,
+                   bool complete);
+
+        void clear();
+
+    private:
+
+        bool m_valid;
+        bool m_complete;
+        std::string m_code;
+        int m_cursor_pos;
+        int m_cursor_start;
+        std::vector<std::string> m_matches;
+    };
+}
+
+#endif
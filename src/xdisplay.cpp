@@ -23,8 +23,11 @@
 #include "pybind11/functional.h"
 #include "pybind11/stl.h"
 
+#include "xeus-python/xmetrics.hpp"
+#include "xeus-python/xstartup.hpp"
 #include "xeus-python/xutils.hpp"
 
+#include "xcode_cache.hpp"
 #include "xdisplay.hpp"
 #include "xinternal_utils.hpp"
 
@@ -38,17 +41,34 @@ namespace xpyt
      * xpublish_display_data implementation *
      ****************************************/
 
+    void count_display_message(const std::string& msg_type, const nl::json& data)
+    {
+        double size = static_cast<double>(estimate_json_size(data));
+        std::string labels = "type=\"" + msg_type + '"';
+        add_counter("iopub_messages_total", labels);
+        add_counter("iopub_bytes_total", labels, size);
+        add_counter("display_bytes_total", "", size);
+    }
+
     void xpublish_display_data(const py::object& data, const py::object& metadata, const py::object& transient, bool update)
     {
+        // No client before the kernel is forked by the zygote
+        if (!is_kernel_available())
+        {
+            return;
+        }
         auto& interp = xeus::get_interpreter();
 
+        nl::json cpp_data = data;
         if (update)
         {
-            interp.update_display_data(data, metadata, transient);
+            count_display_message("update_display_data", cpp_data);
+            interp.update_display_data(std::move(cpp_data), metadata, transient);
         }
         else
         {
-            interp.display_data(data, metadata, transient);
+            count_display_message("display_data", cpp_data);
+            interp.display_data(std::move(cpp_data), metadata, transient);
         }
     }
 
@@ -58,11 +78,16 @@ namespace xpyt
 
     void xpublish_execution_result(const py::int_& execution_count, const py::object& data, const py::object& metadata)
     {
+        if (!is_kernel_available())
+        {
+            return;
+        }
         auto& interp = xeus::get_interpreter();
 
         nl::json cpp_data = data;
         if (cpp_data.size() != 0)
         {
+            count_display_message("execute_result", cpp_data);
             interp.publish_execution_result(execution_count, std::move(cpp_data), metadata);
         }
     }
@@ -73,9 +98,14 @@ namespace xpyt
 
     void xclear(bool wait = false)
     {
+        if (!is_kernel_available())
+        {
+            return;
+        }
         auto& interp = xeus::get_interpreter();
 
         interp.clear_output(wait);
+        add_counter("iopub_messages_total", "type=\"clear_output\"");
     }
 
     /******************
@@ -106,12 +136,73 @@ namespace xpyt
             py::arg("wait") = false
         );
 
-        exec(py::str(R"(
+        display_module.def("update_output_cache_metrics",
+            [](std::size_t entries, std::size_t size, std::size_t evicted)
+            {
+                set_gauge("output_cache_entries", "", static_cast<double>(entries));
+                set_gauge("output_cache_bytes", "", static_cast<double>(size));
+                add_counter("output_cache_evictions_total", "", static_cast<double>(evicted));
+            },
+            py::arg("entries"),
+            py::arg("size"),
+            py::arg("evicted")
+        );
+
+        exec_cached("display_module", R"(
+import atexit
+import os
+import pickle
 import sys
+import warnings
 
 from IPython.core.displaypub import DisplayPublisher
 from IPython.core.displayhook import DisplayHook
 
+from traitlets import Integer, Unicode
+
+
+def estimate_size(obj):
+    """Estimated memory footprint of an output in bytes."""
+    try:
+        memory_usage = getattr(obj, 'memory_usage', None)
+        if callable(memory_usage) and type(obj).__module__.startswith('pandas'):
+            usage = memory_usage(deep=True)
+            return int(usage.sum()) if hasattr(usage, 'sum') else int(usage)
+        nbytes = getattr(obj, 'nbytes', None)
+        if isinstance(nbytes, int):
+            return max(nbytes, sys.getsizeof(obj))
+        return sys.getsizeof(obj)
+    except Exception:
+        return 0
+
+
+class XOutputCache(dict):
+    """Output history (Out, _oh) reloading the entries spilled to disk on access."""
+
+    def __init__(self, *args, **kwargs):
+        super(XOutputCache, self).__init__(*args, **kwargs)
+        self.spilled = {}
+        atexit.register(self.remove_spilled)
+
+    def __missing__(self, key):
+        path = self.spilled.get(key)
+        if path is None:
+            raise KeyError(key)
+        with open(path, 'rb') as f:
+            return pickle.load(f)
+
+    def clear(self):
+        super(XOutputCache, self).clear()
+        self.remove_spilled()
+
+    def remove_spilled(self):
+        for path in self.spilled.values():
+            try:
+                os.remove(path)
+            except OSError:
+                pass
+        self.spilled.clear()
+
 
 class XDisplayPublisher(DisplayPublisher):
     def publish(self, data, metadata=None, source=None, *, transient=None, update=False, **kwargs) -> None:
@@ -122,6 +213,75 @@ class XDisplayPublisher(DisplayPublisher):
 
 
 class XDisplayHook(DisplayHook):
+    max_outputs = Integer(0, help="Maximum number of outputs kept in the output history, 0 for no limit").tag(config=True)
+    max_output_bytes = Integer(0, help="Maximum estimated size of the outputs kept in the output history in bytes, 0 for no limit").tag(config=True)
+    output_spill_dir = Unicode('', help="Directory where the outputs evicted from the output history are pickled, empty to drop them").tag(config=True)
+
+    def __init__(self, *args, **kwargs):
+        super(XDisplayHook, self).__init__(*args, **kwargs)
+        self.output_sizes = {}
+        self.output_bytes = 0
+
+        history_manager = self.shell.history_manager
+        cache = XOutputCache(history_manager.output_hist)
+        history_manager.output_hist = cache
+        for ns in (self.shell.user_ns, self.shell.user_ns_hidden):
+            ns['_oh'] = ns['Out'] = cache
+
+    def update_user_ns(self, result):
+        super(XDisplayHook, self).update_user_ns(result)
+
+        oh = self.shell.history_manager.output_hist
+        n = self.prompt_count
+        if n in oh and n not in self.output_sizes:
+            size = estimate_size(result) if self.max_output_bytes else 0
+            self.output_sizes[n] = size
+            self.output_bytes += size
+            self.evict_outputs()
+
+    def evict_outputs(self):
+        oh = self.shell.history_manager.output_hist
+
+        # Entries culled by IPython itself
+        for n in [n for n in self.output_sizes if n not in oh]:
+            self.output_bytes -= self.output_sizes.pop(n)
+
+        # The oldest entries are evicted first, the last one is always kept
+        evicted = 0
+        for n in sorted(self.output_sizes)[:-1]:
+            over_count = self.max_outputs and len(self.output_sizes) > self.max_outputs
+            over_size = self.max_output_bytes and self.output_bytes > self.max_output_bytes
+            if not (over_count or over_size):
+                break
+            value = oh.pop(n)
+            self.shell.user_ns.pop('_%i' % n, None)
+            self.output_bytes -= self.output_sizes.pop(n)
+            if self.output_spill_dir:
+                self.spill_output(n, value)
+            evicted += 1
+
+        update_output_cache_metrics(len(self.output_sizes), self.output_bytes, evicted)
+
+    def spill_output(self, n, value):
+        oh = self.shell.history_manager.output_hist
+        path = os.path.join(self.output_spill_dir, 'xpython-%i-out-%i.pickle' % (os.getpid(), n))
+        try:
+            os.makedirs(self.output_spill_dir, exist_ok=True)
+            with open(path, 'wb') as f:
+                pickle.dump(value, f, protocol=pickle.HIGHEST_PROTOCOL)
+            oh.spilled[n] = path
+        except Exception as e:
+            warnings.warn('Output %i could not be spilled to disk: %s' % (n, e))
+            try:
+                os.remove(path)
+            except OSError:
+                pass
+
+    def flush(self):
+        super(XDisplayHook, self).flush()
+        self.output_sizes.clear()
+        self.output_bytes = 0
+
     def start_displayhook(self):
         self.data = {}
         self.metadata = {}
@@ -141,7 +301,9 @@ class XDisplayHook(DisplayHook):
 
         self.data = {}
         self.metadata = {}
-        )"), display_module.attr("__dict__"));
+        )", display_module.attr("__dict__"));
+
+        mark_startup_event("display_module");
 
         return display_module;
     }
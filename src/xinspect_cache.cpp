@@ -0,0 +1,123 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cstddef>
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+#include "pybind11/pybind11.h"
+
+#include "xinspect_cache.hpp"
+
+namespace nl = nlohmann;
+namespace py = pybind11;
+
+namespace xpyt
+{
+    /*********************************
+     * xinspect_cache implementation *
+     *********************************/
+
+    xinspect_cache::xinspect_cache(std::size_t capacity)
+        : m_capacity(capacity)
+    {
+    }
+
+    bool xinspect_cache::lookup(const std::string& name, const py::object& object, int detail_level, nl::json& data)
+    {
+        auto it = find(name, object, detail_level);
+        if (it == m_entries.end())
+        {
+            return false;
+        }
+        m_entries.splice(m_entries.begin(), m_entries, it);
+        data = it->m_data;
+        return true;
+    }
+
+    void xinspect_cache::store(const std::string& name, const py::object& object, int detail_level, const nl::json& data)
+    {
+        if (m_capacity == 0)
+        {
+            return;
+        }
+
+        auto it = find(name, object, detail_level);
+        if (it != m_entries.end())
+        {
+            m_entries.erase(it);
+        }
+        else if (m_entries.size() >= m_capacity)
+        {
+            m_entries.pop_back();
+        }
+        m_entries.push_front(entry{name, object, detail_level, data});
+    }
+
+    void xinspect_cache::clear()
+    {
+        m_entries.clear();
+    }
+
+    bool xinspect_cache::enabled() const
+    {
+        return m_capacity != 0;
+    }
+
+    auto xinspect_cache::find(const std::string& name, const py::object& object, int detail_level) -> entry_list::iterator
+    {
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+        {
+            if (it->m_object.is(object) && it->m_detail_level == detail_level && it->m_name == name)
+            {
+                return it;
+            }
+        }
+        return m_entries.end();
+    }
+
+    py::object resolve_name(const py::object& shell, const std::string& name)
+    {
+        std::size_t end = name.find('.');
+        py::str first(name.substr(0, end));
+        py::dict user_ns = shell.attr("user_ns");
+        py::dict builtins = py::module::import("builtins").attr("__dict__");
+
+        py::object object;
+        if (user_ns.contains(first))
+        {
+            object = user_ns[first];
+        }
+        else if (builtins.contains(first))
+        {
+            object = builtins[first];
+        }
+        else
+        {
+            return py::object();
+        }
+
+        while (end != std::string::npos)
+        {
+            std::size_t begin = end + 1;
+            end = name.find('.', begin);
+            std::string attr = name.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+            PyObject* res = PyObject_GetAttrString(object.ptr(), attr.c_str());
+            if (res == nullptr)
+            {
+                PyErr_Clear();
+                return py::object();
+            }
+            object = py::reinterpret_steal<py::object>(res);
+        }
+        return object;
+    }
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_INSPECT_CACHE_HPP
+#define XPYT_INSPECT_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+#include "pybind11/pybind11.h"
+
+namespace nl = nlohmann;
+namespace py = pybind11;
+
+namespace xpyt
+{
+    /**
+     * Keeps the data of the last inspect replies, so that the tooltips that
+     * frontends request repeatedly for the same object do not compute its
+     * docstring, signature and source again.
+     *
+     * An entry is identified by the inspected name, the detail level and
+     * the object the name resolves to, so that a name rebound to another
+     * object is inspected again. The object is held by the entry so that its
+     * identity cannot be reused. The cache must be cleared whenever the
+     * objects may have been modified, i.e. after each execution.
+     *
+     * Must be used with the GIL held.
+     */
+    class xinspect_cache
+    {
+    public:
+
+        explicit xinspect_cache(std::size_t capacity);
+
+        xinspect_cache(const xinspect_cache&) = delete;
+        xinspect_cache& operator=(const xinspect_cache&) = delete;
+
+        // Fills the data of the reply and returns true if the inspection of
+        // the object under the given name is cached
+        bool lookup(const std::string& name, const py::object& object, int detail_level, nl::json& data);
+
+        void store(const std::string& name, const py::object& object, int detail_level, const nl::json& data);
+
+        void clear();
+
+        // Whether the capacity is not null
+        bool enabled() const;
+
+    private:
+
+        struct entry
+        {
+            std::string m_name;
+            py::object m_object;
+            int m_detail_level;
+            nl::json m_data;
+        };
+
+        using entry_list = std::list<entry>;
+
+        entry_list::iterator find(const std::string& name, const py::object& object, int detail_level);
+
+        std::size_t m_capacity;
+        // Most recently used first
+        entry_list m_entries;
+    };
+
+    // Object bound to a dotted name in the namespace of the shell or in the
+    // builtins, a null object if the name cannot be resolved
+    py::object resolve_name(const py::object& shell, const std::string& name);
+}
+
+#endif
@@ -8,6 +8,10 @@
 * The full license is in the file LICENSE, distributed with this software. *
 ****************************************************************************/
 
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
 #include <string>
 #include <vector>
 
@@ -25,6 +29,13 @@
 
 #ifdef WIN32
 #include "Windows.h"
+#include "psapi.h"
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
 #endif
 
 namespace py = pybind11;
@@ -124,4 +135,150 @@ namespace xpyt
                                        content,
                                        get_tmp_suffix());
     }
+
+    std::size_t get_resident_memory()
+    {
+#if defined(WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return static_cast<std::size_t>(counters.WorkingSetSize);
+        }
+        return 0;
+#elif defined(__APPLE__)
+        mach_task_basic_info info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS)
+        {
+            return static_cast<std::size_t>(info.resident_size);
+        }
+        return 0;
+#else
+        std::ifstream statm("/proc/self/statm");
+        std::size_t size = 0;
+        std::size_t resident = 0;
+        if (statm >> size >> resident)
+        {
+            return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        }
+        return 0;
+#endif
+    }
+
+    double get_cpu_time()
+    {
+#if defined(WIN32)
+        FILETIME creation_time, exit_time, kernel_time, user_time;
+        if (GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+        {
+            auto to_seconds = [](const FILETIME& t)
+            {
+                ULARGE_INTEGER value;
+                value.LowPart = t.dwLowDateTime;
+                value.HighPart = t.dwHighDateTime;
+                return static_cast<double>(value.QuadPart) * 1e-7;
+            };
+            return to_seconds(kernel_time) + to_seconds(user_time);
+        }
+        return 0.;
+#else
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+            return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+                + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+        }
+        return 0.;
+#endif
+    }
+
+    std::size_t estimate_json_size(const nl::json& value)
+    {
+        switch (value.type())
+        {
+        case nl::json::value_t::string:
+            return value.get_ref<const std::string&>().size() + 2;
+        case nl::json::value_t::object:
+        {
+            std::size_t size = 2;
+            for (auto it = value.cbegin(); it != value.cend(); ++it)
+            {
+                size += it.key().size() + 4 + estimate_json_size(it.value());
+            }
+            return size;
+        }
+        case nl::json::value_t::array:
+        {
+            std::size_t size = 2;
+            for (const auto& item : value)
+            {
+                size += estimate_json_size(item) + 1;
+            }
+            return size;
+        }
+        default:
+            return 8;
+        }
+    }
+
+    std::size_t utf8_offset(const std::string& str, int code_point)
+    {
+        std::size_t offset = 0;
+        for (int i = 0; i < code_point; ++i)
+        {
+            if (offset >= str.size())
+            {
+                return std::string::npos;
+            }
+            ++offset;
+            while (offset < str.size() && (static_cast<unsigned char>(str[offset]) & 0xC0) == 0x80)
+            {
+                ++offset;
+            }
+        }
+        return offset;
+    }
+
+    int utf8_length(const std::string& str, std::size_t size)
+    {
+        int length = 0;
+        for (std::size_t i = 0; i < size && i < str.size(); ++i)
+        {
+            if ((static_cast<unsigned char>(str[i]) & 0xC0) != 0x80)
+            {
+                ++length;
+            }
+        }
+        return length;
+    }
+
+    bool is_identifier_char(char c)
+    {
+        unsigned char uc = static_cast<unsigned char>(c);
+        return uc >= 0x80 || std::isalnum(uc) || c == '_';
+    }
+
+    namespace
+    {
+        bool kernel_available = true;
+    }
+
+    bool is_kernel_available()
+    {
+        return kernel_available;
+    }
+
+    void set_kernel_available(bool available)
+    {
+        kernel_available = available;
+    }
+
+    bool replace_file(const std::string& from, const std::string& to)
+    {
+#ifdef WIN32
+        return ::MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
 }
@@ -12,13 +12,17 @@
 #ifndef XPYT_INTERNAL_UTILS_HPP
 #define XPYT_INTERNAL_UTILS_HPP
 
+#include <cstddef>
 #include <vector>
 
+#include "nlohmann/json.hpp"
+
 #include "xeus/xcomm.hpp"
 
 #include "pybind11/pybind11.h"
 
 namespace py = pybind11;
+namespace nl = nlohmann;
 
 
 namespace xpyt
@@ -37,6 +41,36 @@ namespace xpyt
     std::string get_tmp_prefix();
     std::string get_tmp_suffix();
     std::string get_cell_tmp_file(const std::string& content);
+
+    // Resident set size of the process in bytes, 0 if not available
+    std::size_t get_resident_memory();
+
+    // User and system CPU time of the process in seconds
+    double get_cpu_time();
+
+    // Approximate size in bytes of the serialized JSON value
+    std::size_t estimate_json_size(const nl::json& value);
+
+    // Cursor positions of the messaging protocol are expressed in unicode
+    // code points. Byte offset of the given code point in a UTF-8 string,
+    // npos if the string is shorter.
+    std::size_t utf8_offset(const std::string& str, int code_point);
+
+    // Number of code points in the first size bytes of a UTF-8 string
+    int utf8_length(const std::string& str, std::size_t size);
+
+    // Whether the byte may be part of a Python identifier, any non ASCII
+    // character is assumed to be a valid identifier character
+    bool is_identifier_char(char c);
+
+    // Whether the kernel exists, i.e. its publisher and comm manager are
+    // registered. False in the zygote, until a kernel is forked.
+    bool is_kernel_available();
+    void set_kernel_available(bool available);
+
+    // Atomically replaces the file to with the file from, also when to
+    // exists on Windows. Returns false on failure.
+    bool replace_file(const std::string& from, const std::string& to);
 }
 
 #endif
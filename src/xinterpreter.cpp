@@ -9,8 +9,10 @@
 ****************************************************************************/
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -26,15 +28,29 @@
 
 #include "xeus-python/xinterpreter.hpp"
 #include "xeus-python/xeus_python_config.hpp"
+#include "xeus-python/xinterrupt.hpp"
+#include "xeus-python/xmetrics.hpp"
+#include "xeus-python/xstartup.hpp"
 #include "xeus-python/xtraceback.hpp"
 #include "xeus-python/xutils.hpp"
 
+#include "xcode_cache.hpp"
 #include "xcomm.hpp"
 #include "xcompiler.hpp"
+#include "xcompletion_cache.hpp"
 #include "xdisplay.hpp"
 #include "xinput.hpp"
+#include "xinspect_cache.hpp"
 #include "xinternal_utils.hpp"
+#include "xmemory_profiler.hpp"
+#include "xmemory_reclaimer.hpp"
+#include "xmodule_index.hpp"
+#include "xname_completer.hpp"
+#include "xpreimport.hpp"
+#include "xscanner.hpp"
 #include "xstream.hpp"
+#include "xtimings.hpp"
+#include "xwatchdog.hpp"
 
 namespace py = pybind11;
 namespace nl = nlohmann;
@@ -42,6 +58,114 @@ using namespace pybind11::literals;
 
 namespace xpyt
 {
+    namespace
+    {
+        // Must be called with the GIL held
+        void add_timings(const py::object& shell, nl::json& reply, const xphase_timer& timer)
+        {
+            if (is_pyobject_true(shell.attr("request_timings")))
+            {
+                if (reply.find("metadata") == reply.end())
+                {
+                    reply["metadata"] = nl::json::object();
+                }
+                reply["metadata"]["timings"] = timer.to_json();
+            }
+        }
+
+        // Must be called with the GIL held. Runs the completion routine within the
+        // time budget, returns its (completions, complete, slow_source) result.
+        // The budget only bounds the Python code: a call to an extension module
+        // or a blocking system call is not interrupted.
+        py::tuple run_completer(const py::object& completer,
+                                xwatchdog& watchdog,
+                                const std::string& code,
+                                int cursor_pos,
+                                bool use_jedi,
+                                double budget)
+        {
+            xresource_limits limits;
+            limits.m_wall_time = budget;
+            watchdog.arm(limits);
+            py::tuple result;
+            try
+            {
+                result = completer(code, cursor_pos, use_jedi);
+            }
+            catch (py::error_already_set& e)
+            {
+                watchdog.disarm();
+                // The budget expired outside of the collection of the completions
+                if (!e.matches(get_kernel_resource_error()))
+                {
+                    throw;
+                }
+                result = py::make_tuple(py::list(), false, use_jedi ? "jedi" : "ipython");
+            }
+
+            // The exception may also have been swallowed by a bare except
+            if (!watchdog.disarm().is_null() && result[2].is_none())
+            {
+                result = py::make_tuple(result[0], false, use_jedi ? "jedi" : "ipython");
+            }
+
+            // The inference of jedi was interrupted at an arbitrary point
+            if (use_jedi && !result[2].is_none())
+            {
+                try
+                {
+                    py::module::import("jedi.cache").attr("clear_time_caches")(true);
+                }
+                catch (py::error_already_set&)
+                {
+                }
+            }
+            return result;
+        }
+
+        // Must be called with the GIL held
+        xresource_limits get_resource_limits(const py::object& shell)
+        {
+            xresource_limits limits;
+            limits.m_wall_time = shell.attr("cell_wall_time_limit").cast<double>();
+            limits.m_cpu_time = shell.attr("cell_cpu_time_limit").cast<double>();
+            limits.m_memory_growth = shell.attr("cell_memory_limit").cast<std::size_t>();
+            return limits;
+        }
+
+        xtraceback_limits get_traceback_limits(const py::object& shell)
+        {
+            xtraceback_limits limits;
+            limits.m_max_frames = shell.attr("traceback_max_frames").cast<std::size_t>();
+            limits.m_max_line_length = shell.attr("traceback_max_line_length").cast<std::size_t>();
+            return limits;
+        }
+
+        // Must be called with the GIL held. Whether the code compiles without
+        // errors nor warnings, which IPython reports as invalid code.
+        bool compiles(const std::string& code)
+        {
+            py::module warnings = py::module::import("warnings");
+            py::object catcher = warnings.attr("catch_warnings")();
+            catcher.attr("__enter__")();
+            warnings.attr("simplefilter")("error");
+            PyObject* compiled = Py_CompileString(code.c_str(), "<input>", Py_file_input);
+            bool res = compiled != nullptr;
+            Py_XDECREF(compiled);
+            PyErr_Clear();
+            catcher.attr("__exit__")(py::none(), py::none(), py::none());
+            return res;
+        }
+
+        std::string format_violation(const nl::json& violation)
+        {
+            std::ostringstream oss;
+            oss << "cell execution exceeded the " << violation["resource"].get<std::string>()
+                << " limit (" << violation["value"].get<double>()
+                << " > " << violation["limit"].get<double>() << ")";
+            return oss.str();
+        }
+    }
 
     interpreter::interpreter(bool redirect_output_enabled/*=true*/, bool redirect_display_enabled/*=true*/)
         : m_redirect_display_enabled{redirect_display_enabled}
@@ -59,6 +183,12 @@ namespace xpyt
 
     void interpreter::configure_impl()
     {
+        // Already configured, e.g. by the zygote before forking the kernel
+        if (m_ipython_shell)
+        {
+            return;
+        }
+
         if (m_release_gil_at_startup)
         {
             // The GIL is not held by default by the interpreter, so every time we need to execute Python code we
@@ -88,8 +218,10 @@ namespace xpyt
         scope["XCachingCompiler"] = get_compiler_module().attr("XCachingCompiler");
 
         scope["get_parent_header"] = py::cpp_function([]() { return py::dict(py::arg("header")=xeus::get_interpreter().parent_header().get<py::object>()); });
+        scope["is_plain_python"] = py::cpp_function([](const std::string& code) { return is_plain_python(code); });
+        scope["mark_startup_event"] = py::cpp_function([](const std::string& name) { mark_startup_event(name); });
 
-        exec(py::str(R"(
+        exec_cached("shell", R"(
 import sys
 
 from IPython.core.interactiveshell import InteractiveShell
@@ -97,6 +229,8 @@ from IPython.core.shellapp import InteractiveShellApp
 from IPython.core.application import BaseIPythonApplication
 from IPython.core import page, payloadpage
 
+from traitlets import Bool, Float, Integer, List, Unicode
+
 
 class XKernel():
     def __init__(self):
@@ -111,9 +245,31 @@ class XKernel():
 
 
 class XPythonShell(InteractiveShell):
+    request_timings = Bool(False, help="Attach per-phase timings to the metadata of the replies").tag(config=True)
+    cell_wall_time_limit = Float(0, min=0, help="Maximum wall time of a cell execution in seconds, 0 for no limit").tag(config=True)
+    cell_cpu_time_limit = Float(0, min=0, help="Maximum CPU time of a cell execution in seconds, 0 for no limit").tag(config=True)
+    cell_memory_limit = Integer(0, min=0, help="Maximum growth of the resident memory during a cell execution in bytes, 0 for no limit").tag(config=True)
+    memory_profiling = Bool(False, help="Attach the memory allocated by each cell to the metadata of the execute replies").tag(config=True)
+    memory_profiling_top = Integer(10, min=0, help="Number of allocation sites reported by the memory profiling").tag(config=True)
+    reclaim_memory = Bool(False, help="Run the garbage collector and give the free memory back to the system after each cell").tag(config=True)
+    preimport_modules = List(Unicode(), help="Modules imported in the background once the kernel is ready").tag(config=True)
+    completion_time_budget = Float(0, help="Maximum duration of the Python code of a completion in seconds, partial matches are returned when it expires, 0 for no limit").tag(config=True)
+    native_completion = Bool(True, help="Complete the names of the namespace and the attributes of modules without IPython").tag(config=True)
+    native_is_complete = Bool(True, help="Check the completeness of plain Python code without the IPython input transformers").tag(config=True)
+    module_index = Bool(True, help="Complete the modules of the import statements from an index of sys.path cached on disk").tag(config=True)
+    completion_cache = Bool(True, help="Narrow the matches of the previous completion while the completed token grows").tag(config=True)
+    inspect_cache_size = Integer(32, min=0, help="Number of inspect replies kept until the next execution, 0 to disable the cache").tag(config=True)
+    traceback_max_frames = Integer(100, help="Maximum number of frames displayed in a traceback once the repeated frames are collapsed, 0 for no limit").tag(config=True)
+    traceback_max_line_length = Integer(1000, help="Maximum number of characters of the lines of a traceback and of the error value, 0 for no limit").tag(config=True)
+    malloc_trim_threshold = Integer(64 * 1024 * 1024, help="Minimum amount of free heap memory in bytes for calling malloc_trim after a cell").tag(config=True)
+
+    # Memory report of the last profiled cell, set by the kernel
+    memory_report = None
+
     def __init__(self, *args, **kwargs):
         super(XPythonShell, self).__init__(*args, **kwargs)
         self.kernel = XKernel()
+        self._default_transforms = self._static_transforms()
 
     def enable_gui(self, gui=None):
         """Not implemented yet."""
@@ -123,6 +279,68 @@ class XPythonShell(InteractiveShell):
         super(XPythonShell, self).init_hooks()
         self.set_hook('show_in_pager', page.as_hook(payloadpage.page), 99)
 
+    def init_magics(self):
+        super(XPythonShell, self).init_magics()
+        self.register_magic_function(self.xmem, magic_kind='line', magic_name='xmem')
+
+    def xmem(self, line):
+        """Memory accounting of the cells.
+
+        %xmem on    enable the memory accounting of the next cells
+        %xmem off   disable the memory accounting
+        %xmem       show the memory report of the last profiled cell
+        """
+        arg = line.strip()
+        if arg in ('on', 'off'):
+            self.memory_profiling = arg == 'on'
+            return
+        if arg:
+            print('Usage: %xmem [on|off]', file=sys.stderr)
+            return
+
+        report = self.memory_report
+        if report is None:
+            print('No memory report, enable the memory accounting with %xmem on')
+            return
+
+        def fmt(size):
+            sign = '-' if size < 0 else '+'
+            size = abs(size)
+            for unit in ('B', 'KiB', 'MiB'):
+                if size < 1024:
+                    return '%s%.1f %s' % (sign, size, unit)
+                size /= 1024.
+            return '%s%.1f GiB' % (sign, size)
+
+        print('RSS:    %s' % fmt(report['rss_delta']))
+        print('Python: %s (peak %s)' % (fmt(report['traced_delta']), fmt(report['traced_peak'])[1:]))
+        for stat in report['top']:
+            print('  %s:%d: %s in %+d blocks' % (stat['filename'], stat['lineno'],
+                                                 fmt(stat['size_diff']), stat['count_diff']))
+
+    def _static_transforms(self):
+        manager = self.input_transformer_manager
+        return (list(manager.cleanup_transforms), list(manager.line_transforms), list(manager.token_transformers))
+
+    # Fast path skipping the static input transformations, which are
+    # a no-op on cells that do not contain any IPython-specific syntax.
+    # It is not taken once users or extensions registered their own.
+    def transform_cell(self, raw_cell):
+        if not is_plain_python(raw_cell) or self._static_transforms() != self._default_transforms:
+            return super(XPythonShell, self).transform_cell(raw_cell)
+
+        cell = raw_cell if raw_cell.endswith('\n') else raw_cell + '\n'
+
+        if len(cell.splitlines()) == 1:
+            # Dynamic transformations (automagic, autocall) still apply
+            with self.builtin_trap:
+                cell = self.prefilter_manager.prefilter_lines(cell) + '\n'
+
+        lines = cell.splitlines(keepends=True)
+        for transform in self.input_transformers_post:
+            lines = transform(lines)
+        return ''.join(lines)
+
     # Workaround for preventing IPython to show error traceback
     # We catch it and will display it later properly
     def showtraceback(self, exc_tuple=None, filename=None, tb_offset=None,
@@ -146,15 +364,19 @@ class XPythonShellApp(BaseIPythonApplication, InteractiveShellApp):
 
         self.init_path()
         self.init_shell()
+        mark_startup_event('ipython_init_shell')
 
         self.init_extensions()
+        mark_startup_event('ipython_init_extensions')
         self.init_code()
+        mark_startup_event('ipython_init_code')
 
         sys.stdout.flush()
         sys.stderr.flush()
 
     def init_shell(self):
         self.shell = XPythonShell.instance(
+            parent=self,
             display_pub_class=XDisplayPublisher,
             displayhook_class=XDisplayHook,
             compiler_class=XCachingCompiler,
@@ -164,7 +386,9 @@ class XPythonShellApp(BaseIPythonApplication, InteractiveShellApp):
     # Overwrite exit logic, this is not part of the kernel protocole
     def exit(self, exit_status=0):
         pass
-        )"), scope);
+        )", scope);
+
+        mark_startup_event("ipython_import");
 
         m_ipython_shell_app = scope["XPythonShellApp"]();
         m_ipython_shell_app.attr("initialize")();
@@ -180,6 +404,52 @@ class XPythonShellApp(BaseIPythonApplication, InteractiveShellApp):
         m_logger.attr("addHandler")(logging.attr("StreamHandler")(m_terminal_stream));
 
         m_ipython_shell.attr("compile").attr("filename_mapper") = traceback_module.attr("register_filename_mapping");
+
+        // Completion routine, compiled once and called for each complete_request
+        py::dict completer_scope;
+        completer_scope["shell"] = m_ipython_shell;
+        completer_scope["lazy_import"] = py::cpp_function([](const std::string& name, const std::string& reason) { return lazy_import(name, reason); });
+        completer_scope["KernelResourceError"] = get_kernel_resource_error();
+        exec_cached("completer", R"(
+def complete(code, cursor_pos, use_jedi=True):
+    """Returns the completions, whether they are complete, and the source
+    that exceeded the time budget of the completion if any."""
+    completer = lazy_import('IPython.core.completer', 'completion')
+    shell_completer = shell.Completer
+    previous_use_jedi = shell_completer.use_jedi
+    raw_completions = []
+    slow_source = None
+    try:
+        shell_completer.use_jedi = previous_use_jedi and use_jedi
+        with completer.provisionalcompleter():
+            # Completions are generated lazily, those generated
+            # before the budget expires are kept
+            for completion in shell_completer.completions(code, cursor_pos):
+                raw_completions.append(completion)
+    except KernelResourceError:
+        slow_source = 'jedi' if shell_completer.use_jedi else 'ipython'
+    finally:
+        shell_completer.use_jedi = previous_use_jedi
+
+    completions = list(completer.rectify_completions(code, raw_completions))
+
+    # IPython truncates the matches that do not come from jedi
+    truncated = sum(1 for c in completions if c._origin != 'jedi') >= getattr(completer, 'MATCHES_LIMIT', 500)
+    return completions, not truncated and slow_source is None, slow_source
+        )", completer_scope);
+        m_completer = completer_scope["complete"];
+
+        p_completion_cache = std::unique_ptr<xcompletion_cache>(new xcompletion_cache());
+        p_inspect_cache = std::unique_ptr<xinspect_cache>(new xinspect_cache(m_ipython_shell.attr("inspect_cache_size").cast<std::size_t>()));
+        p_module_index = std::unique_ptr<xmodule_index>(new xmodule_index());
+        p_name_completer = std::unique_ptr<xname_completer>(new xname_completer(m_ipython_shell, p_module_index.get()));
+        p_watchdog = std::unique_ptr<xwatchdog>(new xwatchdog());
+        p_memory_profiler = std::unique_ptr<xmemory_profiler>(new xmemory_profiler());
+        p_memory_reclaimer = std::unique_ptr<xmemory_reclaimer>(new xmemory_reclaimer());
+        p_preimporter = std::unique_ptr<xpreimporter>(new xpreimporter());
+        m_ipython_shell.attr("push")(py::dict("KernelResourceError"_a=get_kernel_resource_error()), "interactive"_a=false);
+
+        mark_startup_event("configure");
     }
 
     nl::json interpreter::execute_request_impl(int /*execution_count*/,
@@ -189,7 +459,16 @@ class XPythonShellApp(BaseIPythonApplication, InteractiveShellApp):
                                                nl::json user_expressions,
                                                bool allow_stdin)
     {
+        xphase_timer timer("execute");
+        p_memory_reclaimer->cancel();
         py::gil_scoped_acquire acquire;
+        timer.mark("gil");
+        // The namespace of the user may change. The caches hold Python
+        // objects, they are cleared with the GIL held.
+        p_completion_cache->clear();
+        p_inspect_cache->clear();
+        p_name_completer->invalidate();
+        p_module_index->invalidate();
         nl::json kernel_res;
 
         py::module traceback = get_traceback_module();
@@ -197,36 +476,93 @@ class XPythonShellApp(BaseIPythonApplication, InteractiveShellApp):
         // Scope guard performing the temporary monkey patching of input and
         // getpass with a function sending input_request messages.
         auto input_guard = input_redirection(allow_stdin);
+        timer.mark("input_redirection");
 
-        py::object ipython_res = m_ipython_shell.attr("run_cell")(code, "store_history"_a=store_history, "silent"_a=silent);
+        p_memory_profiler->start(m_ipython_shell.attr("memory_profiling").cast<bool>(),
+                                 m_ipython_shell.attr("memory_profiling_top").cast<std::size_t>());
+
+        nl::json violation;
+        {
+            // Allows interrupt_execution() to interrupt the cell from another thread
+            execution_scope interruptible;
+            p_watchdog->arm(get_resource_limits(m_ipython_shell));
+            try
+            {
+                m_ipython_shell.attr("run_cell")(code, "store_history"_a=store_history, "silent"_a=silent);
+            }
+            catch (...)
+            {
+                p_watchdog->disarm();
+                throw;
+            }
+            violation = p_watchdog->disarm();
+        }
+        timer.mark("run_cell");
+
+        nl::json memory_report = p_memory_profiler->stop();
+        if (!memory_report.is_null())
+        {
+            m_ipython_shell.attr("memory_report") = memory_report;
+            timer.mark("memory_report");
+        }
 
         // Get payload
-        kernel_res["payload"] = m_ipython_shell.attr("payload_manager").attr("read_payload")();
+        py::object payload = m_ipython_shell.attr("payload_manager").attr("read_payload")();
         m_ipython_shell.attr("payload_manager").attr("clear_payload")();
+        timer.mark("payload");
 
         if (traceback.attr("get_last_error")().is_none())
         {
+            py::object user_expressions_res = m_ipython_shell.attr("user_expressions")(user_expressions);
+            timer.mark("user_expressions");
+
             kernel_res["status"] = "ok";
-            kernel_res["user_expressions"] = m_ipython_shell.attr("user_expressions")(user_expressions);
+            kernel_res["user_expressions"] = user_expressions_res;
         }
         else
         {
             py::list pyerror = traceback.attr("get_last_error")();
-            xerror error = extract_error(pyerror[0], pyerror[1], pyerror[2]);
+            bool resource_error = !violation.is_null() && py::isinstance(pyerror[1], get_kernel_resource_error());
+            if (resource_error)
+            {
+                pyerror[1].attr("args") = py::make_tuple(format_violation(violation));
+            }
+
+            xerror error = extract_error(pyerror[0], pyerror[1], pyerror[2], get_traceback_limits(m_ipython_shell));
+            timer.mark("traceback");
 
             if (!silent)
             {
                 publish_execution_error(error.m_ename, error.m_evalue, error.m_traceback);
+                add_counter("iopub_messages_total", "type=\"error\"");
             }
 
             kernel_res["status"] = "error";
             kernel_res["ename"] = error.m_ename;
             kernel_res["evalue"] = error.m_evalue;
             kernel_res["traceback"] = error.m_traceback;
+            if (resource_error)
+            {
+                kernel_res["resource_limit"] = violation;
+            }
 
             traceback.attr("reset_last_error")();
         }
 
+        kernel_res["payload"] = payload;
+        timer.mark("reply");
+
+        set_gauge("python_allocated_blocks", "", py::module::import("sys").attr("getallocatedblocks")().cast<double>());
+
+        if (!memory_report.is_null())
+        {
+            kernel_res["metadata"]["memory"] = std::move(memory_report);
+        }
+        if (m_ipython_shell.attr("reclaim_memory").cast<bool>())
+        {
+            p_memory_reclaimer->schedule(m_ipython_shell.attr("malloc_trim_threshold").cast<std::size_t>());
+        }
+        add_timings(m_ipython_shell, kernel_res, timer);
         return kernel_res;
     }
 
@@ -234,47 +570,86 @@ class XPythonShellApp(BaseIPythonApplication, InteractiveShellApp):
         const std::string& code,
         int cursor_pos)
     {
+        xphase_timer timer("complete");
         py::gil_scoped_acquire acquire;
+        timer.mark("gil");
         nl::json kernel_res;
 
-        py::module completer = py::module::import("IPython.core.completer");
+        std::vector<std::string> matches;
+        nl::json metadata = nl::json::object();
+        int cursor_start = cursor_pos;
+        int cursor_end = cursor_pos;
+        bool use_cache = m_ipython_shell.attr("completion_cache").cast<bool>();
+        if (use_cache && p_completion_cache->lookup(code, cursor_pos, matches, cursor_start))
+        {
+            timer.mark("cache");
+            add_counter("completion_cache_requests_total", "result=\"hit\"");
+        }
+        else if (m_ipython_shell.attr("native_completion").cast<bool>()
+                 && p_name_completer->complete(code, cursor_pos, matches, cursor_start))
+        {
+            timer.mark("native");
+            add_counter("completion_native_total", "");
+            if (use_cache)
+            {
+                p_completion_cache->store(code, cursor_pos, cursor_start, cursor_pos, matches, true);
+            }
+        }
+        else
+        {
+            // Both runs of the completer share the same budget
+            double budget = m_ipython_shell.attr("completion_time_budget").cast<double>();
+            auto start = std::chrono::steady_clock::now();
+            py::tuple result = run_completer(m_completer, *p_watchdog, code, cursor_pos, true, budget);
+            timer.mark("completions");
+
+            py::object slow_source = result[2];
+            if (!slow_source.is_none())
+            {
+                add_counter("completion_timeouts_total", "source=\"" + slow_source.cast<std::string>() + '"');
+                metadata["partial"] = true;
+                metadata["slow_source"] = slow_source.cast<std::string>();
+
+                // Nothing was collected from jedi, the other sources are fast
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                if (slow_source.cast<std::string>() == "jedi" && py::len(result[0]) == 0 && elapsed.count() < budget)
+                {
+                    result = run_completer(m_completer, *p_watchdog, code, cursor_pos, false, budget - elapsed.count());
+                    timer.mark("fallback_completions");
+                }
+            }
 
-        py::dict scope;
-        scope["provisionalcompleter"] = completer.attr("provisionalcompleter");
-        scope["rectify_completions"] = completer.attr("rectify_completions");
-        scope["shell"] = m_ipython_shell;
-        scope["code"] = code;
-        scope["cursor_pos"] = cursor_pos;
-        exec(py::str(R"(
-with provisionalcompleter():
-    raw_completions = shell.Completer.completions(code, cursor_pos)
-    completions = list(rectify_completions(code, raw_completions))
-
-    comps = []
-    for comp in completions:
-        comps.append(dict(
-            start=comp.start,
-            end=comp.end,
-            text=comp.text,
-            type=comp.type,
-        ))
-
-if completions:
-    cursor_start = completions[0].start
-    cursor_end = completions[0].end
-    matches = [c.text for c in completions]
-else:
-    cursor_start = cursor_pos
-    cursor_end = cursor_pos
-    matches = []
-        )"), scope);
-
-        kernel_res["matches"] = scope["matches"];
-        kernel_res["cursor_end"] = scope["cursor_end"];
-        kernel_res["cursor_start"] = scope["cursor_start"];
-        kernel_res["metadata"] = nl::json::object();
+            py::list completions = result[0];
+
+            // The completions are rectified, they all have the same range
+            if (!completions.empty())
+            {
+                cursor_start = completions[0].attr("start").cast<int>();
+                cursor_end = completions[0].attr("end").cast<int>();
+            }
+
+            matches.reserve(completions.size());
+            for (const py::handle& completion : completions)
+            {
+                matches.push_back(completion.attr("text").cast<std::string>());
+            }
+
+            // Partial results are not cached, the completer may be faster next time
+            if (use_cache && slow_source.is_none())
+            {
+                p_completion_cache->store(code, cursor_pos, cursor_start, cursor_end, matches, result[1].cast<bool>());
+                add_counter("completion_cache_requests_total", "result=\"miss\"");
+            }
+        }
+
+        kernel_res["matches"] = std::move(matches);
+        kernel_res["cursor_end"] = cursor_end;
+        kernel_res["cursor_start"] = cursor_start;
+        kernel_res["metadata"] = std::move(metadata);
         kernel_res["status"] = "ok";
+        timer.mark("reply");
 
+        add_timings(m_ipython_shell, kernel_res, timer);
         return kernel_res;
     }
 
@@ -282,58 +657,117 @@ else:
                                                int cursor_pos,
                                                int detail_level)
     {
+        xphase_timer timer("inspect");
         py::gil_scoped_acquire acquire;
+        timer.mark("gil");
         nl::json kernel_res;
         nl::json data = nl::json::object();
         bool found = false;
 
-        py::module tokenutil = py::module::import("IPython.utils.tokenutil");
-        py::str name = tokenutil.attr("token_at_cursor")(code, cursor_pos);
+        py::module tokenutil = lazy_import("IPython.utils.tokenutil", "inspection");
+        std::string name = tokenutil.attr("token_at_cursor")(code, cursor_pos).cast<std::string>();
+        timer.mark("token");
 
-        try
+        // Names that cannot be resolved natively, e.g. magics, are not cached.
+        // Resolving the name may run attribute getters, it is skipped when
+        // the cache is disabled.
+        py::object object = p_inspect_cache->enabled() ? resolve_name(m_ipython_shell, name) : py::object();
+        if (object && p_inspect_cache->lookup(name, object, detail_level, data))
         {
-            data = m_ipython_shell.attr("object_inspect_mime")(
-                name,
-                "detail_level"_a=detail_level
-            );
             found = true;
+            timer.mark("cache");
+            add_counter("inspect_cache_requests_total", "result=\"hit\"");
         }
-        catch (py::error_already_set& e)
+        else
         {
-            // pass
+            try
+            {
+                data = m_ipython_shell.attr("object_inspect_mime")(
+                    name,
+                    "detail_level"_a=detail_level
+                );
+                found = true;
+            }
+            catch (py::error_already_set& e)
+            {
+                // pass
+            }
+            timer.mark("inspect");
+
+            if (object && found)
+            {
+                p_inspect_cache->store(name, object, detail_level, data);
+                add_counter("inspect_cache_requests_total", "result=\"miss\"");
+            }
         }
 
         kernel_res["data"] = data;
         kernel_res["metadata"] = nl::json::object();
         kernel_res["found"] = found;
         kernel_res["status"] = "ok";
+        timer.mark("reply");
+
+        add_timings(m_ipython_shell, kernel_res, timer);
         return kernel_res;
     }
 
     nl::json interpreter::is_complete_request_impl(const std::string& code)
     {
+        xphase_timer timer("is_complete");
         py::gil_scoped_acquire acquire;
+        timer.mark("gil");
         nl::json kernel_res;
 
-        py::object transformer_manager = py::getattr(m_ipython_shell, "input_transformer_manager", py::none());
-        if (transformer_manager.is_none())
+        std::size_t indent = 0;
+        code_status status = m_ipython_shell.attr("native_is_complete").cast<bool>()
+            ? check_complete(code, indent)
+            : code_status::unknown;
+        if ((status == code_status::complete || status == code_status::open_block) && !compiles(code))
         {
-            transformer_manager = m_ipython_shell.attr("input_splitter");
+            status = code_status::unknown;
         }
+        timer.mark("scan");
 
-        py::list result = transformer_manager.attr("check_complete")(code);
-        auto status = result[0].cast<std::string>();
-
-        kernel_res["status"] = status;
-        if (status.compare("incomplete") == 0)
+        if (status == code_status::complete)
+        {
+            kernel_res["status"] = "complete";
+            add_counter("is_complete_native_total", "");
+        }
+        else if (status != code_status::unknown)
         {
-            kernel_res["indent"] = std::string(result[1].cast<std::size_t>(), ' ');
+            kernel_res["status"] = "incomplete";
+            kernel_res["indent"] = std::string(indent, ' ');
+            add_counter("is_complete_native_total", "");
         }
+        else
+        {
+            py::object transformer_manager = py::getattr(m_ipython_shell, "input_transformer_manager", py::none());
+            if (transformer_manager.is_none())
+            {
+                transformer_manager = m_ipython_shell.attr("input_splitter");
+            }
+
+            py::list result = transformer_manager.attr("check_complete")(code);
+            timer.mark("check_complete");
+
+            auto ipython_status = result[0].cast<std::string>();
+
+            kernel_res["status"] = ipython_status;
+            if (ipython_status.compare("incomplete") == 0)
+            {
+                kernel_res["indent"] = std::string(result[1].cast<std::size_t>(), ' ');
+            }
+        }
+        timer.mark("reply");
+
+        add_timings(m_ipython_shell, kernel_res, timer);
         return kernel_res;
     }
 
     nl::json interpreter::kernel_info_request_impl()
     {
+        add_counter("requests_total", "type=\"kernel_info\"");
+
         nl::json result;
         result["implementation"] = "xeus-python";
         result["implementation_version"] = XPYT_VERSION;
@@ -378,16 +812,53 @@ else:
         });
 
         result["status"] = "ok";
+
+        // The reply to the first kernel_info_request is the
+        // last step of the startup
+        static bool first_request = true;
+        if (first_request)
+        {
+            first_request = false;
+            mark_startup_event("kernel_info_reply");
+            write_startup_report();
+
+            // Only the modules configured by the user, the dependencies of
+            // the kernel are either imported with IPython or only needed
+            // when a debugger is attached
+            xpreimporter::module_list modules;
+            {
+                py::gil_scoped_acquire acquire;
+                for (const py::handle& name : m_ipython_shell.attr("preimport_modules"))
+                {
+                    modules.emplace_back(name.cast<std::string>(), "preimport_modules");
+                }
+            }
+            p_preimporter->start(std::move(modules));
+
+            // The modules are indexed once the kernel is ready, the
+            // completion of the imports uses IPython until then
+            py::gil_scoped_acquire acquire;
+            if (m_ipython_shell.attr("module_index").cast<bool>())
+            {
+                p_module_index->refresh();
+            }
+        }
         return result;
     }
 
     void interpreter::shutdown_request_impl()
     {
+        add_counter("requests_total", "type=\"shutdown\"");
     }
 
     nl::json interpreter::internal_request_impl(const nl::json& content)
     {
+        add_counter("requests_total", "type=\"internal\"");
         py::gil_scoped_acquire acquire;
+        p_completion_cache->clear();
+        p_inspect_cache->clear();
+        p_name_completer->invalidate();
+        p_module_index->invalidate();
         std::string code = content.value("code", "");
         nl::json reply;
         try
@@ -398,7 +869,7 @@ else:
         }
         catch (py::error_already_set& e)
         {
-            xerror error = extract_error(e);
+            xerror error = extract_error(e, get_traceback_limits(m_ipython_shell));
 
             publish_execution_error(error.m_ename, error.m_evalue, error.m_traceback);
             error.m_traceback.resize(1);
@@ -0,0 +1,229 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "pybind11/pybind11.h"
+
+#include "xeus-python/xinterrupt.hpp"
+
+namespace py = pybind11;
+
+namespace xpyt
+{
+    namespace
+    {
+        // The flags are read by the SIGINT handler, they must be lock-free
+        struct execution_state
+        {
+            std::mutex m_mutex;
+            std::atomic<bool> m_executing{false};
+            std::atomic<bool> m_main_thread{false};
+            unsigned long m_thread_ident = 0;
+#ifndef _WIN32
+            pthread_t m_thread;
+#endif
+        };
+
+        execution_state& get_execution_state()
+        {
+            static execution_state state;
+            return state;
+        }
+
+        // Sets the flag checked by the interpreter at the next bytecode
+        // boundary, the KeyboardInterrupt is raised in the main thread.
+        // Async-signal-safe.
+        void set_interrupt()
+        {
+#if PY_VERSION_HEX >= 0x030A0000
+            PyErr_SetInterruptEx(SIGINT);
+#else
+            PyErr_SetInterrupt();
+#endif
+        }
+
+#ifndef _WIN32
+        std::atomic<bool> handler_installed{false};
+
+        // Written by the SIGINT handler when the cell is executed by another
+        // thread than the main thread, read by the interrupt thread
+        int interrupt_pipe[2] = {-1, -1};
+
+        void handle_sigint(int /*sig*/)
+        {
+            int saved_errno = errno;
+            execution_state& state = get_execution_state();
+            // Outside of the execution of a cell, the interrupt is dropped
+            if (state.m_executing.load())
+            {
+                if (state.m_main_thread.load())
+                {
+                    set_interrupt();
+                    // The executing thread is signaled as well, so that its
+                    // blocking system calls (sleep, I/O) fail with EINTR
+                    if (!pthread_equal(pthread_self(), state.m_thread))
+                    {
+                        pthread_kill(state.m_thread, SIGINT);
+                    }
+                }
+                else
+                {
+                    char c = 0;
+                    ssize_t res = ::write(interrupt_pipe[1], &c, 1);
+                    static_cast<void>(res);
+                }
+            }
+            errno = saved_errno;
+        }
+#endif
+    }
+
+    execution_scope::execution_scope()
+    {
+        unsigned long main_thread_ident = py::module::import("threading").attr("main_thread")().attr("ident").cast<unsigned long>();
+
+        execution_state& state = get_execution_state();
+        std::lock_guard<std::mutex> lock(state.m_mutex);
+        state.m_thread_ident = PyThread_get_thread_ident();
+        state.m_main_thread = state.m_thread_ident == main_thread_ident;
+#ifndef _WIN32
+        state.m_thread = pthread_self();
+#endif
+        state.m_executing = true;
+    }
+
+    execution_scope::~execution_scope()
+    {
+        execution_state& state = get_execution_state();
+        {
+            std::lock_guard<std::mutex> lock(state.m_mutex);
+            state.m_executing = false;
+        }
+
+        // An interrupt received at the very end of the execution must not
+        // be raised in the code of the kernel that follows
+        if (state.m_main_thread)
+        {
+            PyObject* type = nullptr;
+            PyObject* value = nullptr;
+            PyObject* traceback = nullptr;
+            PyErr_Fetch(&type, &value, &traceback);
+            if (PyErr_CheckSignals() < 0)
+            {
+                if (PyErr_ExceptionMatches(PyExc_KeyboardInterrupt))
+                {
+                    PyErr_Clear();
+                }
+                else
+                {
+                    PyErr_WriteUnraisable(nullptr);
+                }
+            }
+            PyErr_Restore(type, value, traceback);
+        }
+        else
+        {
+            PyThreadState_SetAsyncExc(state.m_thread_ident, nullptr);
+        }
+    }
+
+    void interrupt_execution()
+    {
+        execution_state& state = get_execution_state();
+        std::unique_lock<std::mutex> lock(state.m_mutex);
+        if (!state.m_executing)
+        {
+            return;
+        }
+
+        if (state.m_main_thread)
+        {
+            // Python signal handlers only run in the main thread, the
+            // KeyboardInterrupt is raised at the next bytecode boundary.
+            set_interrupt();
+#ifndef _WIN32
+            // Also wakes up blocking system calls with EINTR, the handler
+            // only sets the interrupt flag again
+            if (handler_installed)
+            {
+                pthread_kill(state.m_thread, SIGINT);
+            }
+#endif
+        }
+        else
+        {
+            // The GIL must be acquired before the mutex, as in execution_scope
+            unsigned long thread_ident = state.m_thread_ident;
+            lock.unlock();
+
+            PyGILState_STATE gil_state = PyGILState_Ensure();
+            {
+                std::lock_guard<std::mutex> guard(state.m_mutex);
+                if (state.m_executing && state.m_thread_ident == thread_ident)
+                {
+                    PyThreadState_SetAsyncExc(thread_ident, PyExc_KeyboardInterrupt);
+                }
+            }
+            PyGILState_Release(gil_state);
+        }
+    }
+
+    void install_interrupt_handler()
+    {
+#ifndef _WIN32
+        if (handler_installed || ::pipe(interrupt_pipe) < 0)
+        {
+            return;
+        }
+        ::fcntl(interrupt_pipe[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(interrupt_pipe[1], F_SETFD, FD_CLOEXEC);
+        ::fcntl(interrupt_pipe[1], F_SETFL, O_NONBLOCK);
+
+        // Interrupts of cells executed by other threads than the main thread
+        // require the GIL, which cannot be acquired in a signal handler
+        std::thread([]()
+        {
+            char c;
+            while (true)
+            {
+                ssize_t res = ::read(interrupt_pipe[0], &c, 1);
+                if (res > 0)
+                {
+                    interrupt_execution();
+                }
+                else if (res == 0 || errno != EINTR)
+                {
+                    return;
+                }
+            }
+        }).detach();
+
+        // No SA_RESTART, blocking system calls are interrupted
+        struct sigaction action;
+        action.sa_handler = handle_sigint;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = 0;
+        ::sigaction(SIGINT, &action, nullptr);
+        handler_installed = true;
+#endif
+    }
+}
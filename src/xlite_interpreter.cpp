@@ -0,0 +1,531 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+#include "xeus/xinterpreter.hpp"
+
+#include "pybind11/functional.h"
+
+#include "pybind11_json/pybind11_json.hpp"
+
+#include "xeus-python/xeus_python_config.hpp"
+#include "xeus-python/xinterrupt.hpp"
+#include "xeus-python/xlite_interpreter.hpp"
+#include "xeus-python/xmetrics.hpp"
+#include "xeus-python/xstartup.hpp"
+#include "xeus-python/xtraceback.hpp"
+#include "xeus-python/xutils.hpp"
+
+#include "xcode_cache.hpp"
+#include "xcomm.hpp"
+#include "xinput.hpp"
+#include "xinternal_utils.hpp"
+#include "xstream.hpp"
+#include "xtimings.hpp"
+
+namespace py = pybind11;
+namespace nl = nlohmann;
+using namespace pybind11::literals;
+
+namespace xpyt
+{
+    namespace
+    {
+        // The lite shell has no configuration, the tracebacks are capped
+        // as with the default traits of the IPython shell
+        xtraceback_limits get_traceback_limits()
+        {
+            xtraceback_limits limits;
+            limits.m_max_frames = 100;
+            limits.m_max_line_length = 1000;
+            return limits;
+        }
+
+        // Rich representations supported by the display hook, in the order
+        // of IPython's DisplayFormatter
+        const std::vector<std::pair<std::string, std::string>>& get_repr_methods()
+        {
+            static const std::vector<std::pair<std::string, std::string>> methods = {
+                {"_repr_html_", "text/html"},
+                {"_repr_markdown_", "text/markdown"},
+                {"_repr_svg_", "image/svg+xml"},
+                {"_repr_png_", "image/png"},
+                {"_repr_jpeg_", "image/jpeg"},
+                {"_repr_latex_", "text/latex"},
+                {"_repr_json_", "application/json"},
+                {"_repr_javascript_", "application/javascript"}
+            };
+            return methods;
+        }
+
+        // Must be called with the GIL held. Representations raising an
+        // exception are ignored, the text/plain one is always present.
+        std::pair<nl::json, nl::json> format_mimebundle(const py::object& value)
+        {
+            nl::json data = nl::json::object();
+            nl::json metadata = nl::json::object();
+
+            // Classes have the _repr_*_ methods of their instances
+            if (!py::isinstance<py::type>(value))
+            {
+                py::object py_data;
+                try
+                {
+                    if (py::hasattr(value, "_repr_mimebundle_"))
+                    {
+                        py::object bundle = value.attr("_repr_mimebundle_")();
+                        if (py::isinstance<py::tuple>(bundle))
+                        {
+                            metadata = py::tuple(bundle)[1];
+                            bundle = py::tuple(bundle)[0];
+                        }
+                        data = bundle;
+                    }
+                }
+                catch (py::error_already_set&)
+                {
+                }
+
+                py::object b64encode = py::none();
+                for (const auto& method : get_repr_methods())
+                {
+                    if (data.find(method.second) != data.end() || !py::hasattr(value, method.first.c_str()))
+                    {
+                        continue;
+                    }
+                    try
+                    {
+                        py::object repr = value.attr(method.first.c_str())();
+                        if (py::isinstance<py::tuple>(repr))
+                        {
+                            metadata[method.second] = py::tuple(repr)[1];
+                            repr = py::tuple(repr)[0];
+                        }
+                        if (repr.is_none())
+                        {
+                            continue;
+                        }
+                        if (py::isinstance<py::bytes>(repr))
+                        {
+                            if (b64encode.is_none())
+                            {
+                                b64encode = py::module::import("base64").attr("b64encode");
+                            }
+                            repr = b64encode(repr).attr("decode")("ascii");
+                        }
+                        data[method.second] = repr;
+                    }
+                    catch (py::error_already_set&)
+                    {
+                    }
+                }
+            }
+
+            data["text/plain"] = py::repr(value).cast<std::string>();
+            return std::make_pair(std::move(data), std::move(metadata));
+        }
+    }
+
+    lite_interpreter::lite_interpreter()
+    {
+        xeus::register_interpreter(this);
+
+        py::module sys = py::module::import("sys");
+        py::module stream_module = get_stream_module();
+
+        sys.attr("stdout") = stream_module.attr("Stream")("stdout");
+        sys.attr("stderr") = stream_module.attr("Stream")("stderr");
+    }
+
+    lite_interpreter::~lite_interpreter()
+    {
+    }
+
+    void lite_interpreter::configure_impl()
+    {
+        // Already configured, e.g. by the zygote before forking the kernel
+        if (m_shell)
+        {
+            return;
+        }
+
+        if (m_release_gil_at_startup)
+        {
+            m_release_gil = gil_scoped_release_ptr(new py::gil_scoped_release());
+        }
+
+        py::gil_scoped_acquire acquire;
+
+        // Monkey patching "from ipykernel.comm import Comm"
+        py::module sys = py::module::import("sys");
+        sys.attr("modules")["ipykernel.comm"] = get_comm_module();
+
+        py::dict scope;
+        exec_cached("lite_shell", R"(
+import ast
+import builtins
+import codeop
+import inspect
+import linecache
+import re
+import rlcompleter
+import sys
+import types
+
+
+class LiteShell(object):
+    """Minimal shell executing the cells in the namespace of __main__."""
+
+    def __init__(self):
+        self.module = types.ModuleType('__main__')
+        self.user_ns = self.module.__dict__
+        self.user_ns['__builtins__'] = builtins
+        sys.modules['__main__'] = self.module
+
+    def run_cell(self, code, filename):
+        # Makes the source of the cell available to the tracebacks
+        linecache.cache[filename] = (len(code), None, code.splitlines(True), filename)
+
+        tree = ast.parse(code, filename, 'exec')
+        last = None
+        if tree.body and isinstance(tree.body[-1], ast.Expr):
+            last = ast.Interactive([tree.body.pop()])
+
+        if tree.body:
+            exec(compile(tree, filename, 'exec'), self.user_ns)
+        # Compiled in 'single' mode so that its value goes to sys.displayhook
+        if last is not None:
+            exec(compile(last, filename, 'single'), self.user_ns)
+
+    def evaluate(self, expression):
+        return eval(expression, self.user_ns)
+
+    def complete(self, code, cursor_pos):
+        token = re.search(r'[\w.]*$', code[:cursor_pos]).group()
+        matches = []
+        if token:
+            completer = rlcompleter.Completer(self.user_ns)
+            state = 0
+            while True:
+                match = completer.complete(token, state)
+                if match is None:
+                    break
+                match = match.rstrip('(')
+                if match not in matches:
+                    matches.append(match)
+                state += 1
+        return matches, cursor_pos - len(token)
+
+    def inspect(self, code, cursor_pos, detail_level):
+        start = cursor_pos
+        while start > 0 and (code[start - 1].isalnum() or code[start - 1] in '_.'):
+            start -= 1
+        end = cursor_pos
+        while end < len(code) and (code[end].isalnum() or code[end] == '_'):
+            end += 1
+        name = code[start:end].strip('.')
+        if not name:
+            return None
+
+        parts = name.split('.')
+        try:
+            if parts[0] in self.user_ns:
+                obj = self.user_ns[parts[0]]
+            else:
+                obj = getattr(builtins, parts[0])
+            for part in parts[1:]:
+                obj = getattr(obj, part)
+        except Exception:
+            return None
+
+        lines = ['Type:      ' + type(obj).__name__]
+        try:
+            lines.append('Signature: ' + name + str(inspect.signature(obj)))
+        except (TypeError, ValueError):
+            pass
+        doc = inspect.getdoc(obj)
+        if doc:
+            lines.append('Docstring:\n' + doc)
+        if detail_level > 0:
+            try:
+                lines.append('Source:\n' + inspect.getsource(obj))
+            except (OSError, TypeError):
+                pass
+        return '\n'.join(lines)
+
+    def is_complete(self, code):
+        try:
+            compiled = codeop.compile_command(code, '<input>', 'exec')
+        except (SyntaxError, OverflowError, ValueError):
+            return 'invalid', ''
+
+        lines = code.rstrip('\n').split('\n')
+        last = lines[-1]
+        indent = len(last) - len(last.lstrip())
+        if compiled is None:
+            if last.rstrip().endswith(':'):
+                indent += 4
+            return 'incomplete', ' ' * indent
+        # Still in an indented block, a blank line ends it
+        if indent and not code.endswith('\n'):
+            return 'incomplete', ' ' * indent
+        return 'complete', ''
+        )", scope);
+        mark_startup_event("lite_shell");
+
+        m_shell = scope["LiteShell"]();
+        sys.attr("displayhook") = py::cpp_function([this](const py::object& value) { display_result(value); });
+
+        mark_startup_event("configure");
+    }
+
+    void lite_interpreter::display_result(const py::object& value)
+    {
+        if (value.is_none())
+        {
+            return;
+        }
+
+        py::module::import("builtins").attr("_") = value;
+        if (m_silent)
+        {
+            return;
+        }
+
+        auto bundle = format_mimebundle(value);
+        add_counter("iopub_messages_total", "type=\"execute_result\"");
+        publish_execution_result(m_execution_count, std::move(bundle.first), std::move(bundle.second));
+    }
+
+    nl::json lite_interpreter::execute_request_impl(int execution_counter,
+                                                    const std::string& code,
+                                                    bool silent,
+                                                    bool /*store_history*/,
+                                                    nl::json user_expressions,
+                                                    bool allow_stdin)
+    {
+        xphase_timer timer("execute");
+        py::gil_scoped_acquire acquire;
+        timer.mark("gil");
+        nl::json kernel_res;
+
+        m_execution_count = execution_counter;
+        m_silent = silent;
+
+        auto input_guard = input_redirection(allow_stdin);
+        timer.mark("input_redirection");
+
+        std::string filename = get_cell_tmp_file(code);
+        register_filename_mapping(filename, execution_counter);
+
+        try
+        {
+            {
+                // Allows interrupt_execution() to interrupt the cell from another thread
+                execution_scope interruptible;
+                m_shell.attr("run_cell")(code, filename);
+            }
+            timer.mark("run_cell");
+
+            nl::json user_expressions_res = nl::json::object();
+            for (auto it = user_expressions.begin(); it != user_expressions.end(); ++it)
+            {
+                try
+                {
+                    auto bundle = format_mimebundle(m_shell.attr("evaluate")(it.value().get<std::string>()));
+                    user_expressions_res[it.key()] = {
+                        {"status", "ok"},
+                        {"data", std::move(bundle.first)},
+                        {"metadata", std::move(bundle.second)}
+                    };
+                }
+                catch (py::error_already_set& e)
+                {
+                    xerror error = extract_error(e, get_traceback_limits());
+                    user_expressions_res[it.key()] = {
+                        {"status", "error"},
+                        {"ename", error.m_ename},
+                        {"evalue", error.m_evalue},
+                        {"traceback", error.m_traceback}
+                    };
+                }
+            }
+            timer.mark("user_expressions");
+
+            kernel_res["status"] = "ok";
+            kernel_res["user_expressions"] = std::move(user_expressions_res);
+        }
+        catch (py::error_already_set& e)
+        {
+            timer.mark("run_cell");
+            xerror error = extract_error(e, get_traceback_limits());
+            timer.mark("traceback");
+
+            if (!silent)
+            {
+                publish_execution_error(error.m_ename, error.m_evalue, error.m_traceback);
+                add_counter("iopub_messages_total", "type=\"error\"");
+            }
+
+            kernel_res["status"] = "error";
+            kernel_res["ename"] = error.m_ename;
+            kernel_res["evalue"] = error.m_evalue;
+            kernel_res["traceback"] = error.m_traceback;
+        }
+
+        kernel_res["payload"] = nl::json::array();
+        timer.mark("reply");
+        return kernel_res;
+    }
+
+    nl::json lite_interpreter::complete_request_impl(const std::string& code, int cursor_pos)
+    {
+        xphase_timer timer("complete");
+        py::gil_scoped_acquire acquire;
+        timer.mark("gil");
+        nl::json kernel_res;
+
+        py::tuple res = m_shell.attr("complete")(code, cursor_pos);
+        timer.mark("completions");
+
+        kernel_res["matches"] = res[0];
+        kernel_res["cursor_start"] = res[1];
+        kernel_res["cursor_end"] = cursor_pos;
+        kernel_res["metadata"] = nl::json::object();
+        kernel_res["status"] = "ok";
+        timer.mark("reply");
+        return kernel_res;
+    }
+
+    nl::json lite_interpreter::inspect_request_impl(const std::string& code,
+                                                    int cursor_pos,
+                                                    int detail_level)
+    {
+        xphase_timer timer("inspect");
+        py::gil_scoped_acquire acquire;
+        timer.mark("gil");
+        nl::json kernel_res;
+
+        py::object text = m_shell.attr("inspect")(code, cursor_pos, detail_level);
+        timer.mark("inspect");
+
+        kernel_res["data"] = nl::json::object();
+        if (!text.is_none())
+        {
+            kernel_res["data"]["text/plain"] = text.cast<std::string>();
+        }
+        kernel_res["metadata"] = nl::json::object();
+        kernel_res["found"] = !text.is_none();
+        kernel_res["status"] = "ok";
+        timer.mark("reply");
+        return kernel_res;
+    }
+
+    nl::json lite_interpreter::is_complete_request_impl(const std::string& code)
+    {
+        xphase_timer timer("is_complete");
+        py::gil_scoped_acquire acquire;
+        timer.mark("gil");
+        nl::json kernel_res;
+
+        py::tuple result = m_shell.attr("is_complete")(code);
+        timer.mark("check_complete");
+
+        auto status = result[0].cast<std::string>();
+        kernel_res["status"] = status;
+        if (status == "incomplete")
+        {
+            kernel_res["indent"] = result[1].cast<std::string>();
+        }
+        timer.mark("reply");
+        return kernel_res;
+    }
+
+    nl::json lite_interpreter::kernel_info_request_impl()
+    {
+        add_counter("requests_total", "type=\"kernel_info\"");
+
+        nl::json result;
+        result["implementation"] = "xeus-python";
+        result["implementation_version"] = XPYT_VERSION;
+
+        std::string banner = ""
+              "  __  _____ _   _ ___\n"
+              "  \\ \\/ / _ \\ | | / __|\n"
+              "   >  <  __/ |_| \\__ \\\n"
+              "  /_/\\_\\___|\\__,_|___/\n"
+              "\n"
+              "  xeus-python: a Jupyter kernel for Python (lite mode)\n"
+              "  Python ";
+        banner.append(PY_VERSION);
+        result["banner"] = banner;
+        result["debugger"] = false;
+
+        result["language_info"]["name"] = "python";
+        result["language_info"]["version"] = PY_VERSION;
+        result["language_info"]["mimetype"] = "text/x-python";
+        result["language_info"]["file_extension"] = ".py";
+
+        result["help_links"] = nl::json::array();
+        result["help_links"][0] = nl::json::object({
+            {"text", "Xeus-Python Reference"},
+            {"url", "https://xeus-python.readthedocs.io"}
+        });
+
+        result["status"] = "ok";
+
+        static bool first_request = true;
+        if (first_request)
+        {
+            first_request = false;
+            mark_startup_event("kernel_info_reply");
+            write_startup_report();
+        }
+        return result;
+    }
+
+    void lite_interpreter::shutdown_request_impl()
+    {
+        add_counter("requests_total", "type=\"shutdown\"");
+    }
+
+    nl::json lite_interpreter::internal_request_impl(const nl::json& content)
+    {
+        add_counter("requests_total", "type=\"internal\"");
+        py::gil_scoped_acquire acquire;
+        std::string code = content.value("code", "");
+        nl::json reply;
+        try
+        {
+            exec(py::str(code));
+
+            reply["status"] = "ok";
+        }
+        catch (py::error_already_set& e)
+        {
+            xerror error = extract_error(e, get_traceback_limits());
+
+            publish_execution_error(error.m_ename, error.m_evalue, error.m_traceback);
+            error.m_traceback.resize(1);
+            error.m_traceback[0] = code;
+
+            reply["status"] = "error";
+            reply["ename"] = error.m_ename;
+            reply["evalue"] = error.m_evalue;
+            reply["traceback"] = error.m_traceback;
+        }
+        return reply;
+    }
+}
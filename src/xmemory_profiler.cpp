@@ -0,0 +1,141 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cstddef>
+#include <cstdint>
+
+#include "nlohmann/json.hpp"
+
+#include "pybind11/pybind11.h"
+
+#include "xinternal_utils.hpp"
+#include "xmemory_profiler.hpp"
+
+namespace nl = nlohmann;
+namespace py = pybind11;
+
+namespace xpyt
+{
+    namespace
+    {
+        std::int64_t difference(std::size_t after, std::size_t before)
+        {
+            return static_cast<std::int64_t>(after) - static_cast<std::int64_t>(before);
+        }
+
+        // Ignores the allocations of tracemalloc itself and the ones without
+        // any known source location
+        py::object take_snapshot(const py::module& tracemalloc)
+        {
+            py::object filter = tracemalloc.attr("Filter");
+            py::list filters;
+            filters.append(filter(false, tracemalloc.attr("__file__")));
+            filters.append(filter(false, "<unknown>"));
+            return tracemalloc.attr("take_snapshot")().attr("filter_traces")(filters);
+        }
+    }
+
+    xmemory_profiler::xmemory_profiler()
+        : m_started(false)
+        , m_owns_tracing(false)
+        , m_top_count(0)
+        , m_start_rss(0)
+        , m_start_traced(0)
+    {
+    }
+
+    void xmemory_profiler::start(bool enabled, std::size_t top_count)
+    {
+        py::module tracemalloc = py::module::import("tracemalloc");
+        bool is_tracing = tracemalloc.attr("is_tracing")().cast<bool>();
+
+        if (!enabled)
+        {
+            if (m_owns_tracing && is_tracing)
+            {
+                tracemalloc.attr("stop")();
+            }
+            m_owns_tracing = false;
+            return;
+        }
+
+        if (!is_tracing)
+        {
+            tracemalloc.attr("start")();
+            m_owns_tracing = true;
+        }
+
+        if (py::hasattr(tracemalloc, "reset_peak"))
+        {
+            tracemalloc.attr("reset_peak")();
+        }
+
+        m_started = true;
+        m_top_count = top_count;
+        m_start_rss = get_resident_memory();
+        m_start_traced = py::tuple(tracemalloc.attr("get_traced_memory")())[0].cast<std::size_t>();
+        m_start_snapshot = m_top_count != 0 ? take_snapshot(tracemalloc) : py::object();
+    }
+
+    nl::json xmemory_profiler::stop()
+    {
+        if (!m_started)
+        {
+            return nullptr;
+        }
+        m_started = false;
+
+        py::module tracemalloc = py::module::import("tracemalloc");
+        std::size_t rss = get_resident_memory();
+        py::tuple traced_memory = tracemalloc.attr("get_traced_memory")();
+        std::size_t traced = traced_memory[0].cast<std::size_t>();
+        std::size_t peak = traced_memory[1].cast<std::size_t>();
+
+        nl::json report;
+        report["rss_before"] = m_start_rss;
+        report["rss_after"] = rss;
+        report["rss_delta"] = difference(rss, m_start_rss);
+        report["traced_before"] = m_start_traced;
+        report["traced_after"] = traced;
+        report["traced_delta"] = difference(traced, m_start_traced);
+        report["traced_peak"] = peak;
+
+        nl::json top = nl::json::array();
+        if (m_start_snapshot)
+        {
+            py::object snapshot = take_snapshot(tracemalloc);
+            py::list stats = snapshot.attr("compare_to")(m_start_snapshot, "lineno");
+            for (const py::handle& stat : stats)
+            {
+                if (top.size() == m_top_count)
+                {
+                    break;
+                }
+                std::int64_t size_diff = stat.attr("size_diff").cast<std::int64_t>();
+                if (size_diff == 0)
+                {
+                    continue;
+                }
+                py::object frame = stat.attr("traceback")[py::int_(0)];
+                top.push_back({
+                    {"filename", frame.attr("filename").cast<std::string>()},
+                    {"lineno", frame.attr("lineno").cast<int>()},
+                    {"size_diff", size_diff},
+                    {"count_diff", stat.attr("count_diff").cast<std::int64_t>()},
+                    {"size", stat.attr("size").cast<std::size_t>()}
+                });
+            }
+            m_start_snapshot = py::object();
+        }
+        report["top"] = std::move(top);
+
+        return report;
+    }
+}
@@ -0,0 +1,61 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_MEMORY_PROFILER_HPP
+#define XPYT_MEMORY_PROFILER_HPP
+
+#include <cstddef>
+
+#include "nlohmann/json.hpp"
+
+#include "pybind11/pybind11.h"
+
+namespace nl = nlohmann;
+namespace py = pybind11;
+
+namespace xpyt
+{
+    /**
+     * Measures the memory allocated during the execution of a cell: the
+     * variation of the resident set size of the process, the variation of
+     * the memory traced by tracemalloc, and the source lines responsible for
+     * the largest variations, obtained by comparing tracemalloc snapshots.
+     *
+     * tracemalloc is started when the profiler is first enabled, and stopped
+     * when it is disabled if it was not already tracing beforehand.
+     * All the methods must be called with the GIL held.
+     */
+    class xmemory_profiler
+    {
+    public:
+
+        xmemory_profiler();
+
+        xmemory_profiler(const xmemory_profiler&) = delete;
+        xmemory_profiler& operator=(const xmemory_profiler&) = delete;
+
+        // Does nothing but stopping tracemalloc if required when enabled is false
+        void start(bool enabled, std::size_t top_count);
+
+        // Returns the memory report of the cell, or null if not started
+        nl::json stop();
+
+    private:
+
+        bool m_started;
+        bool m_owns_tracing;
+        std::size_t m_top_count;
+        std::size_t m_start_rss;
+        std::size_t m_start_traced;
+        py::object m_start_snapshot;
+    };
+}
+
+#endif
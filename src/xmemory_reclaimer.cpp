@@ -0,0 +1,158 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+#include "pybind11/pybind11.h"
+
+#include "xeus-python/xmetrics.hpp"
+
+#include "xinternal_utils.hpp"
+#include "xmemory_reclaimer.hpp"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace py = pybind11;
+
+namespace xpyt
+{
+    namespace
+    {
+        // Leaves time for the reply and the idle status to be sent
+        const std::chrono::milliseconds reclaim_delay(100);
+    }
+
+    std::size_t get_free_heap_memory()
+    {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        struct mallinfo2 info = ::mallinfo2();
+        return info.fordblks;
+#elif defined(__GLIBC__)
+        struct mallinfo info = ::mallinfo();
+        return static_cast<std::size_t>(static_cast<unsigned int>(info.fordblks));
+#else
+        return 0;
+#endif
+    }
+
+    /************************************
+     * xmemory_reclaimer implementation *
+     ************************************/
+
+    xmemory_reclaimer::xmemory_reclaimer()
+        : m_stopped(false)
+        , m_pending(false)
+        , m_generation(0)
+        , m_trim_threshold(0)
+    {
+    }
+
+    xmemory_reclaimer::~xmemory_reclaimer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond.notify_all();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    void xmemory_reclaimer::cancel()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = false;
+        ++m_generation;
+    }
+
+    void xmemory_reclaimer::schedule(std::size_t trim_threshold)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = true;
+        ++m_generation;
+        m_deadline = clock_type::now() + reclaim_delay;
+        m_trim_threshold = trim_threshold;
+
+        // The thread is only started when the reclamation is actually used
+        if (!m_thread.joinable())
+        {
+            m_thread = std::thread(&xmemory_reclaimer::run, this);
+        }
+        m_cond.notify_all();
+    }
+
+    void xmemory_reclaimer::run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopped)
+        {
+            if (!m_pending)
+            {
+                m_cond.wait(lock);
+                continue;
+            }
+
+            if (clock_type::now() < m_deadline)
+            {
+                m_cond.wait_until(lock, m_deadline);
+                continue;
+            }
+
+            m_pending = false;
+            std::size_t trim_threshold = m_trim_threshold;
+            std::size_t generation = m_generation;
+            lock.unlock();
+            reclaim(trim_threshold, generation);
+            lock.lock();
+        }
+    }
+
+    void xmemory_reclaimer::reclaim(std::size_t trim_threshold, std::size_t generation)
+    {
+        std::size_t rss_before = get_resident_memory();
+
+        {
+            py::gil_scoped_acquire acquire;
+            {
+                // A cell may have started while waiting for the GIL
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_generation != generation || m_stopped)
+                {
+                    return;
+                }
+            }
+            std::size_t collected = py::module::import("gc").attr("collect")(1).cast<std::size_t>();
+            add_counter("gc_collections_total", "");
+            add_counter("gc_collected_objects_total", "", static_cast<double>(collected));
+        }
+
+#if defined(__GLIBC__)
+        if (get_free_heap_memory() > trim_threshold)
+        {
+            ::malloc_trim(0);
+            add_counter("malloc_trim_total", "");
+        }
+#else
+        (void)trim_threshold;
+#endif
+
+        std::size_t rss_after = get_resident_memory();
+        if (rss_before > rss_after)
+        {
+            add_counter("memory_reclaimed_bytes_total", "", static_cast<double>(rss_before - rss_after));
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_MEMORY_RECLAIMER_HPP
+#define XPYT_MEMORY_RECLAIMER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+namespace xpyt
+{
+    /**
+     * Gives memory back to the system once a cell has been executed: runs a
+     * collection of the young generations of the garbage collector, then
+     * releases the free pages of the heap with malloc_trim (glibc only) when
+     * the memory held by the allocator without being used exceeds a threshold.
+     *
+     * The reclamation runs in a background thread, after a short delay so that
+     * the execute reply is sent first. It is skipped if another cell started
+     * in the meantime.
+     */
+    class xmemory_reclaimer
+    {
+    public:
+
+        xmemory_reclaimer();
+        ~xmemory_reclaimer();
+
+        xmemory_reclaimer(const xmemory_reclaimer&) = delete;
+        xmemory_reclaimer& operator=(const xmemory_reclaimer&) = delete;
+
+        // Called when a cell starts, cancels the pending reclamation
+        void cancel();
+
+        // Called when a cell is done
+        void schedule(std::size_t trim_threshold);
+
+    private:
+
+        using clock_type = std::chrono::steady_clock;
+
+        void run();
+        void reclaim(std::size_t trim_threshold, std::size_t generation);
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::thread m_thread;
+        bool m_stopped;
+        bool m_pending;
+        // Incremented by cancel and schedule, to detect cells started
+        // during the reclamation
+        std::size_t m_generation;
+        clock_type::time_point m_deadline;
+        std::size_t m_trim_threshold;
+    };
+
+    // Memory held by the allocator without being used by the process,
+    // 0 if not available
+    std::size_t get_free_heap_memory();
+}
+
+#endif
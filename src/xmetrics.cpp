@@ -0,0 +1,386 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "xeus-python/xmetrics.hpp"
+
+#include "xinternal_utils.hpp"
+#include "xtimings.hpp"
+
+namespace xpyt
+{
+    /***********************************
+     * metrics registry implementation *
+     ***********************************/
+
+    namespace
+    {
+        struct metric_family
+        {
+            bool m_is_counter;
+            std::map<std::string, double> m_samples;
+        };
+
+        using metric_map = std::map<std::string, metric_family>;
+
+        metric_map& get_metric_map()
+        {
+            static metric_map mm;
+            return mm;
+        }
+
+        std::mutex& get_metric_map_mutex()
+        {
+            static std::mutex m;
+            return m;
+        }
+
+        using collector_list = std::vector<std::function<void()>>;
+
+        collector_list& get_collector_list()
+        {
+            static collector_list cl;
+            return cl;
+        }
+
+        std::mutex& get_collector_list_mutex()
+        {
+            static std::mutex m;
+            return m;
+        }
+
+        std::string format_value(double value)
+        {
+            std::ostringstream oss;
+            if (std::isinf(value))
+            {
+                oss << (value > 0 ? "+Inf" : "-Inf");
+            }
+            else if (value == std::floor(value) && std::fabs(value) < 1e15)
+            {
+                oss << static_cast<long long>(value);
+            }
+            else
+            {
+                oss << std::setprecision(12) << value;
+            }
+            return oss.str();
+        }
+
+        void format_sample(std::ostream& out,
+                           const std::string& name,
+                           const std::string& labels,
+                           double value)
+        {
+            out << name;
+            if (!labels.empty())
+            {
+                out << '{' << labels << '}';
+            }
+            out << ' ' << format_value(value) << '\n';
+        }
+
+        void format_histogram(std::ostream& out,
+                              const std::string& name,
+                              const std::string& labels,
+                              const xhistogram_snapshot& histogram)
+        {
+            std::string prefix = labels.empty() ? std::string() : labels + ',';
+            std::uint64_t cumulative_count = 0;
+            for (std::size_t i = 0; i < histogram.m_counts.size(); ++i)
+            {
+                cumulative_count += histogram.m_counts[i];
+                double bound = i < histogram.m_bounds.size() ? histogram.m_bounds[i]
+                                                             : std::numeric_limits<double>::infinity();
+                format_sample(out, name + "_bucket",
+                              prefix + "le=\"" + format_value(bound) + '"',
+                              static_cast<double>(cumulative_count));
+            }
+            format_sample(out, name + "_sum", labels, histogram.m_sum);
+            format_sample(out, name + "_count", labels, static_cast<double>(histogram.m_count));
+        }
+
+        void update_metric(const std::string& name, const std::string& labels, double value, bool is_counter)
+        {
+            std::lock_guard<std::mutex> lock(get_metric_map_mutex());
+            metric_family& family = get_metric_map()[name];
+            family.m_is_counter = is_counter;
+            if (is_counter)
+            {
+                family.m_samples[labels] += value;
+            }
+            else
+            {
+                family.m_samples[labels] = value;
+            }
+        }
+    }
+
+    void add_counter(const std::string& name, const std::string& labels, double value)
+    {
+        update_metric(name, labels, value, true);
+    }
+
+    void set_gauge(const std::string& name, const std::string& labels, double value)
+    {
+        update_metric(name, labels, value, false);
+    }
+
+    void register_metrics_collector(std::function<void()> collector)
+    {
+        std::lock_guard<std::mutex> lock(get_collector_list_mutex());
+        get_collector_list().push_back(std::move(collector));
+    }
+
+    std::string format_metrics()
+    {
+        // Collectors update the metrics with set_gauge, which
+        // locks the metric map, hence they are called on a copy
+        collector_list collectors;
+        {
+            std::lock_guard<std::mutex> lock(get_collector_list_mutex());
+            collectors = get_collector_list();
+        }
+        for (const auto& collector : collectors)
+        {
+            collector();
+        }
+
+        std::ostringstream out;
+
+        {
+            std::lock_guard<std::mutex> lock(get_metric_map_mutex());
+            for (const auto& family : get_metric_map())
+            {
+                std::string name = "xpython_" + family.first;
+                out << "# TYPE " << name << (family.second.m_is_counter ? " counter\n" : " gauge\n");
+                for (const auto& sample : family.second.m_samples)
+                {
+                    format_sample(out, name, sample.first, sample.second);
+                }
+            }
+        }
+
+        // Phase histograms are named "<request>.<phase>", request histograms "<request>"
+        std::map<std::string, xhistogram_snapshot> histograms = snapshot_phase_histograms();
+        std::ostringstream phases;
+        double gil_wait = 0.;
+        out << "# TYPE xpython_request_duration_seconds histogram\n";
+        for (const auto& h : histograms)
+        {
+            std::size_t dot = h.first.find('.');
+            if (dot == std::string::npos)
+            {
+                format_histogram(out, "xpython_request_duration_seconds",
+                                 "type=\"" + h.first + '"', h.second);
+            }
+            else
+            {
+                std::string phase = h.first.substr(dot + 1);
+                format_histogram(phases, "xpython_request_phase_duration_seconds",
+                                 "type=\"" + h.first.substr(0, dot) + "\",phase=\"" + phase + '"',
+                                 h.second);
+                if (phase == "gil")
+                {
+                    gil_wait += h.second.m_sum;
+                }
+            }
+        }
+        out << "# TYPE xpython_request_phase_duration_seconds histogram\n" << phases.str();
+        out << "# TYPE xpython_gil_wait_seconds_total counter\n";
+        format_sample(out, "xpython_gil_wait_seconds_total", "", gil_wait);
+
+        std::size_t rss = get_resident_memory();
+        if (rss != 0)
+        {
+            out << "# TYPE xpython_resident_memory_bytes gauge\n";
+            format_sample(out, "xpython_resident_memory_bytes", "", static_cast<double>(rss));
+        }
+
+        return out.str();
+    }
+
+    /************************************
+     * xmetrics_exporter implementation *
+     ************************************/
+
+    xmetrics_exporter::xmetrics_exporter(const std::string& file_path,
+                                         const std::string& socket_path,
+                                         double interval)
+        : m_file_path(file_path)
+        , m_socket_path(socket_path)
+        , m_interval(interval)
+        , m_stopped(false)
+    {
+        if (!m_file_path.empty())
+        {
+            m_file_writer = std::thread(&xmetrics_exporter::run_file_writer, this);
+        }
+        if (!m_socket_path.empty())
+        {
+#ifdef _WIN32
+            std::clog << "Metrics export on a Unix domain socket is not supported on Windows" << std::endl;
+#else
+            m_socket_server = std::thread(&xmetrics_exporter::run_socket_server, this);
+#endif
+        }
+    }
+
+    xmetrics_exporter::~xmetrics_exporter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond.notify_all();
+        if (m_file_writer.joinable())
+        {
+            m_file_writer.join();
+        }
+        if (m_socket_server.joinable())
+        {
+            m_socket_server.join();
+        }
+    }
+
+    void xmetrics_exporter::write_file()
+    {
+        // Write in a temporary file which then replaces the metrics file,
+        // so that readers never see a missing or partially written file
+        std::string tmp_path = m_file_path + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::out | std::ios::trunc);
+            out << format_metrics();
+            if (!out)
+            {
+                out.close();
+                std::remove(tmp_path.c_str());
+                return;
+            }
+        }
+        if (!replace_file(tmp_path, m_file_path))
+        {
+            std::remove(tmp_path.c_str());
+        }
+    }
+
+    void xmetrics_exporter::run_file_writer()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopped)
+        {
+            write_file();
+            m_cond.wait_for(lock, std::chrono::duration<double>(m_interval), [this]() { return m_stopped.load(); });
+        }
+        write_file();
+    }
+
+    void xmetrics_exporter::run_socket_server()
+    {
+#ifndef _WIN32
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (m_socket_path.size() >= sizeof(address.sun_path))
+        {
+            std::clog << "Metrics socket path is too long: " << m_socket_path << std::endl;
+            return;
+        }
+        std::strncpy(address.sun_path, m_socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+        int server_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ::unlink(m_socket_path.c_str());
+        if (server_fd < 0
+            || ::bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+            || ::listen(server_fd, 16) < 0)
+        {
+            std::clog << "Could not listen on metrics socket " << m_socket_path
+                      << ": " << std::strerror(errno) << std::endl;
+            if (server_fd >= 0)
+            {
+                ::close(server_fd);
+            }
+            return;
+        }
+
+#ifdef MSG_NOSIGNAL
+        const int send_flags = MSG_NOSIGNAL;
+#else
+        const int send_flags = 0;
+#endif
+
+        while (!m_stopped)
+        {
+            pollfd server_poll = {server_fd, POLLIN, 0};
+            if (::poll(&server_poll, 1, 200) <= 0)
+            {
+                continue;
+            }
+
+            int client_fd = ::accept(server_fd, nullptr, nullptr);
+            if (client_fd < 0)
+            {
+                continue;
+            }
+
+            // Consume the request if any, its content is ignored
+            pollfd client_poll = {client_fd, POLLIN, 0};
+            if (::poll(&client_poll, 1, 100) > 0)
+            {
+                char buffer[4096];
+                (void)::recv(client_fd, buffer, sizeof(buffer), 0);
+            }
+
+            std::string body = format_metrics();
+            std::string response = "HTTP/1.0 200 OK\r\n"
+                                   "Content-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                   "\r\n" + body;
+            std::size_t sent = 0;
+            while (sent < response.size())
+            {
+                ssize_t res = ::send(client_fd, response.data() + sent, response.size() - sent, send_flags);
+                if (res <= 0)
+                {
+                    break;
+                }
+                sent += static_cast<std::size_t>(res);
+            }
+            ::close(client_fd);
+        }
+
+        ::close(server_fd);
+        ::unlink(m_socket_path.c_str());
+#endif
+    }
+}
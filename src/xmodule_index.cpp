@@ -0,0 +1,470 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+#include "pybind11/pybind11.h"
+
+#include "xeus-python/xmetrics.hpp"
+
+#include "xcode_cache.hpp"
+#include "xinternal_utils.hpp"
+#include "xmodule_index.hpp"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef WIN32
+#include "Windows.h"
+#include <direct.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+namespace py = pybind11;
+namespace nl = nlohmann;
+using namespace pybind11::literals;
+
+namespace xpyt
+{
+    namespace
+    {
+        // Version of the format of the cache file
+        const int cache_version = 2;
+
+        // Modification time of the directory, -1 if it is not a directory
+        long long get_directory_mtime(const std::string& path)
+        {
+            struct stat st;
+            if (::stat(path.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFDIR)
+            {
+                return -1;
+            }
+            return static_cast<long long>(st.st_mtime);
+        }
+
+        bool is_file(const std::string& path)
+        {
+            struct stat st;
+            return ::stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+        }
+
+        std::vector<std::string> list_directory(const std::string& path)
+        {
+            std::vector<std::string> res;
+#ifdef WIN32
+            WIN32_FIND_DATAA data;
+            HANDLE handle = ::FindFirstFileA((path + "\\*").c_str(), &data);
+            if (handle == INVALID_HANDLE_VALUE)
+            {
+                return res;
+            }
+            do
+            {
+                res.push_back(data.cFileName);
+            }
+            while (::FindNextFileA(handle, &data));
+            ::FindClose(handle);
+#else
+            DIR* dir = ::opendir(path.c_str());
+            if (dir == nullptr)
+            {
+                return res;
+            }
+            while (struct dirent* entry = ::readdir(dir))
+            {
+                res.push_back(entry->d_name);
+            }
+            ::closedir(dir);
+#endif
+            return res;
+        }
+
+        std::string get_current_dir()
+        {
+            char buffer[4096];
+#ifdef WIN32
+            return ::_getcwd(buffer, sizeof(buffer)) != nullptr ? std::string(buffer) : std::string(".");
+#else
+            return ::getcwd(buffer, sizeof(buffer)) != nullptr ? std::string(buffer) : std::string(".");
+#endif
+        }
+
+        long get_process_id()
+        {
+#ifdef WIN32
+            return static_cast<long>(::_getpid());
+#else
+            return static_cast<long>(::getpid());
+#endif
+        }
+    }
+
+    /********************************
+     * xmodule_index implementation *
+     ********************************/
+
+    xmodule_index::xmodule_index()
+        : m_stopped(false)
+        , m_pending(false)
+        , m_stale(false)
+        , m_ready(false)
+    {
+    }
+
+    xmodule_index::~xmodule_index()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond.notify_all();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    void xmodule_index::refresh()
+    {
+        std::vector<std::string> paths = get_sys_path();
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // The thread is only started when the index is actually used
+        if (!m_thread.joinable())
+        {
+            py::module sys = py::module::import("sys");
+            for (const py::handle& suffix : py::module::import("importlib.machinery").attr("all_suffixes")())
+            {
+                m_suffixes.push_back(suffix.cast<std::string>());
+            }
+            for (const py::handle& name : sys.attr("builtin_module_names"))
+            {
+                m_builtin_modules.push_back(name.cast<std::string>());
+            }
+
+            // One cache file per Python installation, the modules of a
+            // directory depend on the extension suffixes of the interpreter
+            std::string dir = get_cache_dir();
+            if (!dir.empty())
+            {
+                try
+                {
+                    py::module::import("os").attr("makedirs")(dir, "exist_ok"_a=true);
+                    std::string key = sys.attr("executable").cast<std::string>() + '\n' + sys.attr("version").cast<std::string>();
+                    std::ostringstream oss;
+                    oss << dir << "/modules-" << std::hex << hash_source(key) << ".json";
+                    m_cache_path = oss.str();
+                }
+                catch (py::error_already_set&)
+                {
+                }
+            }
+
+            m_thread = std::thread(&xmodule_index::run, this);
+        }
+
+        m_paths = std::move(paths);
+        m_pending = true;
+        m_stale = false;
+        m_cond.notify_all();
+    }
+
+    void xmodule_index::invalidate()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stale = true;
+    }
+
+    bool xmodule_index::find_prefix(const std::string& prefix, std::vector<std::string>& res)
+    {
+        std::vector<std::string> paths = get_sys_path();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_thread.joinable())
+        {
+            return false;
+        }
+
+        // The current index is used while it is refreshed, unless sys.path changed
+        if (m_stale || paths != m_paths)
+        {
+            m_paths = paths;
+            m_pending = true;
+            m_stale = false;
+            m_cond.notify_all();
+        }
+        if (!m_ready || paths != m_index_paths)
+        {
+            return false;
+        }
+
+        m_index.find_prefix(prefix, res);
+        return true;
+    }
+
+    std::vector<std::string> xmodule_index::get_sys_path() const
+    {
+        std::vector<std::string> res;
+        for (const py::handle& path : py::module::import("sys").attr("path"))
+        {
+            if (py::isinstance<py::str>(path))
+            {
+                res.push_back(path.cast<std::string>());
+            }
+        }
+        return res;
+    }
+
+    void xmodule_index::run()
+    {
+        load_cache();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopped)
+        {
+            if (!m_pending)
+            {
+                m_cond.wait(lock);
+                continue;
+            }
+
+            m_pending = false;
+            std::vector<std::string> paths = m_paths;
+            lock.unlock();
+            update(paths);
+            lock.lock();
+        }
+    }
+
+    void xmodule_index::update(const std::vector<std::string>& paths)
+    {
+        directory_map directories;
+        bool changed = false;
+        std::size_t listed = 0;
+        for (const auto& path : paths)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_stopped)
+                {
+                    return;
+                }
+            }
+
+            // The empty entry stands for the current directory
+            std::string directory = path.empty() ? get_current_dir() : path;
+            if (directories.find(directory) != directories.end())
+            {
+                continue;
+            }
+
+            long long mtime = get_directory_mtime(directory);
+            auto it = m_directories.find(directory);
+            if (it != m_directories.end() && it->second.m_mtime == mtime)
+            {
+                auto package = it->second.m_packages.cbegin();
+                while (package != it->second.m_packages.cend()
+                       && get_directory_mtime(directory + '/' + package->first) == package->second)
+                {
+                    ++package;
+                }
+                if (package == it->second.m_packages.cend())
+                {
+                    directories[directory] = std::move(it->second);
+                    continue;
+                }
+            }
+
+            directory_entry& entry = directories[directory];
+            entry.m_mtime = mtime;
+            if (mtime != -1)
+            {
+                list_modules(directory, entry);
+                ++listed;
+                // The directory may change again within the resolution of the
+                // modification time, it is listed again at the next update
+                long long last_mtime = mtime;
+                for (const auto& package : entry.m_packages)
+                {
+                    last_mtime = std::max(last_mtime, package.second);
+                }
+                if (last_mtime + 1 >= static_cast<long long>(std::time(nullptr)))
+                {
+                    entry.m_mtime = -2;
+                }
+            }
+            changed = true;
+        }
+        changed = changed || directories.size() != m_directories.size();
+        m_directories = std::move(directories);
+
+        std::vector<std::string> modules = m_builtin_modules;
+        for (const auto& directory : m_directories)
+        {
+            modules.insert(modules.end(), directory.second.m_modules.cbegin(), directory.second.m_modules.cend());
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_index.assign(std::move(modules));
+            m_index_paths = paths;
+            m_ready = true;
+        }
+
+        add_counter("module_index_listed_directories_total", "", static_cast<double>(listed));
+        if (changed)
+        {
+            store_cache();
+        }
+    }
+
+    // Same rules as IPython.core.completerlib.module_list: modules whose name
+    // is an identifier followed by an import suffix, and packages with an
+    // __init__ module
+    void xmodule_index::list_modules(const std::string& directory, directory_entry& entry) const
+    {
+        std::vector<std::string>& res = entry.m_modules;
+        res.clear();
+        entry.m_packages.clear();
+        for (const auto& name : list_directory(directory))
+        {
+            if (name.empty() || !is_identifier_char(name[0]) || std::isdigit(static_cast<unsigned char>(name[0])))
+            {
+                continue;
+            }
+
+            std::size_t stem = 0;
+            while (stem < name.size() && is_identifier_char(name[stem]))
+            {
+                ++stem;
+            }
+
+            if (stem == name.size())
+            {
+                long long mtime = get_directory_mtime(directory + '/' + name);
+                if (mtime == -1)
+                {
+                    continue;
+                }
+                entry.m_packages[name] = mtime;
+                for (const auto& suffix : m_suffixes)
+                {
+                    if (is_file(directory + '/' + name + "/__init__" + suffix))
+                    {
+                        res.push_back(name);
+                        break;
+                    }
+                }
+            }
+            else if (std::find(m_suffixes.cbegin(), m_suffixes.cend(), name.substr(stem)) != m_suffixes.cend())
+            {
+                res.push_back(name.substr(0, stem));
+            }
+        }
+    }
+
+    void xmodule_index::load_cache()
+    {
+        if (m_cache_path.empty())
+        {
+            return;
+        }
+
+        std::ifstream in(m_cache_path);
+        if (!in)
+        {
+            return;
+        }
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        // A corrupted or outdated file is ignored, it is overwritten by the next update
+        nl::json cache = nl::json::parse(content, nullptr, false);
+        try
+        {
+            if (cache.is_discarded() || cache.value("version", 0) != cache_version)
+            {
+                return;
+            }
+            for (const auto& item : cache.at("directories").items())
+            {
+                directory_entry& entry = m_directories[item.key()];
+                entry.m_mtime = item.value().at("mtime").get<long long>();
+                entry.m_modules = item.value().at("modules").get<std::vector<std::string>>();
+                entry.m_packages = item.value().at("packages").get<std::map<std::string, long long>>();
+            }
+        }
+        catch (nl::json::exception&)
+        {
+            m_directories.clear();
+        }
+    }
+
+    void xmodule_index::store_cache() const
+    {
+        if (m_cache_path.empty())
+        {
+            return;
+        }
+
+        nl::json cache;
+        cache["version"] = cache_version;
+        cache["directories"] = nl::json::object();
+        for (const auto& directory : m_directories)
+        {
+            cache["directories"][directory.first] = {
+                {"mtime", directory.second.m_mtime},
+                {"modules", directory.second.m_modules},
+                {"packages", directory.second.m_packages}
+            };
+        }
+        std::string content;
+        try
+        {
+            content = cache.dump();
+        }
+        catch (nl::json::exception&)
+        {
+            // File names that are not valid UTF-8
+            return;
+        }
+
+        // Written in a temporary file which then replaces the cache, so
+        // that concurrent kernel launches never read a partially written file
+        std::string tmp_path = m_cache_path + ".tmp" + std::to_string(get_process_id());
+        {
+            std::ofstream out(tmp_path, std::ios::out | std::ios::trunc);
+            out.write(content.data(), static_cast<std::streamsize>(content.size()));
+            if (!out)
+            {
+                out.close();
+                std::remove(tmp_path.c_str());
+                return;
+            }
+        }
+        if (!replace_file(tmp_path, m_cache_path))
+        {
+            std::remove(tmp_path.c_str());
+        }
+    }
+}
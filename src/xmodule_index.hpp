@@ -0,0 +1,103 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_MODULE_INDEX_HPP
+#define XPYT_MODULE_INDEX_HPP
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "xname_completer.hpp"
+
+namespace xpyt
+{
+    /**
+     * Index of the names of the top-level modules that can be imported, for
+     * the completion of the import statements.
+     *
+     * The modules found in each directory of sys.path are stored with the
+     * modification times of the directory and of its subdirectories in a
+     * file of the user cache directory (e.g.
+     * ~/.cache/xeus-python/modules-<hash>.json), so that a kernel only lists
+     * again the directories that changed since the last launch. The
+     * subdirectories are checked since adding an __init__ module to one of
+     * them does not change the modification time of the directory. The
+     * directories are listed in a background thread, when the kernel starts
+     * and after the executions changing sys.path or the content of its
+     * directories. Zip files and eggs are not indexed.
+     */
+    class xmodule_index
+    {
+    public:
+
+        xmodule_index();
+        ~xmodule_index();
+
+        xmodule_index(const xmodule_index&) = delete;
+        xmodule_index& operator=(const xmodule_index&) = delete;
+
+        // Refreshes the index in the background, must be called with the GIL
+        // held. The thread is started at the first call.
+        void refresh();
+
+        // The directories of sys.path may have changed, they are checked
+        // again at the next completion
+        void invalidate();
+
+        // Appends the modules starting with the prefix and returns true if the
+        // index covers the current sys.path. Must be called with the GIL held.
+        bool find_prefix(const std::string& prefix, std::vector<std::string>& res);
+
+    private:
+
+        struct directory_entry
+        {
+            long long m_mtime;
+            std::vector<std::string> m_modules;
+            // Modification times of the subdirectories, which are or may
+            // become packages
+            std::map<std::string, long long> m_packages;
+        };
+
+        using directory_map = std::map<std::string, directory_entry>;
+
+        std::vector<std::string> get_sys_path() const;
+
+        void run();
+        void update(const std::vector<std::string>& paths);
+        void list_modules(const std::string& directory, directory_entry& entry) const;
+        void load_cache();
+        void store_cache() const;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::thread m_thread;
+        bool m_stopped;
+        bool m_pending;
+        bool m_stale;
+        bool m_ready;
+        // sys.path requested and sys.path covered by the index
+        std::vector<std::string> m_paths;
+        std::vector<std::string> m_index_paths;
+        xname_index m_index;
+
+        // Set by the first refresh, then only used by the thread
+        std::vector<std::string> m_suffixes;
+        std::vector<std::string> m_builtin_modules;
+        std::string m_cache_path;
+        directory_map m_directories;
+    };
+}
+
+#endif
@@ -0,0 +1,536 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "pybind11/pybind11.h"
+
+#include "xinternal_utils.hpp"
+#include "xmodule_index.hpp"
+#include "xname_completer.hpp"
+
+namespace py = pybind11;
+
+namespace xpyt
+{
+    namespace
+    {
+        // Maximum number of modules whose attributes are indexed
+        const std::size_t max_indexed_modules = 64;
+
+        bool starts_with(const std::string& str, const std::string& prefix)
+        {
+            return str.compare(0, prefix.size(), prefix) == 0;
+        }
+
+        bool starts_with_word(const std::string& str, const std::string& word)
+        {
+            return starts_with(str, word) && (str.size() == word.size() || !is_identifier_char(str[word.size()]));
+        }
+
+        std::string to_lower(const std::string& str)
+        {
+            std::string res(str);
+            std::transform(res.begin(), res.end(), res.begin(),
+                           [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+            return res;
+        }
+
+        // Order of the completions of jedi: public names, then names starting
+        // with an underscore, then with two underscores
+        void sort_matches(std::vector<std::string>& matches)
+        {
+            std::vector<std::tuple<int, std::string, std::string>> keys;
+            keys.reserve(matches.size());
+            for (auto& match : matches)
+            {
+                int rank = starts_with(match, "__") ? 2 : (starts_with(match, "_") ? 1 : 0);
+                keys.emplace_back(rank, to_lower(match), std::move(match));
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+            matches.clear();
+            for (auto& key : keys)
+            {
+                matches.push_back(std::move(std::get<2>(key)));
+            }
+        }
+
+        // "import " or "from " followed by the token
+        bool is_module_statement(const std::string& line)
+        {
+            std::size_t end = line.find_last_not_of(" \t");
+            return end != std::string::npos && end + 1 < line.size()
+                && (line.compare(0, end + 1, "import") == 0 || line.compare(0, end + 1, "from") == 0);
+        }
+
+        std::vector<std::string> public_names(const py::handle& names)
+        {
+            std::vector<std::string> res;
+            for (const py::handle& name : names)
+            {
+                if (!py::isinstance<py::str>(name))
+                {
+                    continue;
+                }
+                std::string str = name.cast<std::string>();
+                if (!str.empty() && str[0] != '_')
+                {
+                    res.push_back(std::move(str));
+                }
+            }
+            return res;
+        }
+
+        // Code preceding the cursor, as seen by the completion
+        struct xcode_context
+        {
+            bool m_in_string = false;
+            bool m_in_comment = false;
+            int m_paren_depth = 0;
+            std::size_t m_line_begin = 0;
+            // Beginning and end of the names outside of string literals and
+            // comments, except attributes
+            std::vector<std::pair<std::size_t, std::size_t>> m_names;
+        };
+
+        xcode_context scan_code(const std::string& code, std::size_t cursor)
+        {
+            xcode_context context;
+            char quote = '\0';
+            bool triple_quoted = false;
+            for (std::size_t i = 0; i < cursor; ++i)
+            {
+                char c = code[i];
+                if (c == '\n')
+                {
+                    context.m_line_begin = i + 1;
+                    context.m_in_comment = false;
+                }
+
+                if (context.m_in_comment)
+                {
+                    continue;
+                }
+
+                if (quote != '\0')
+                {
+                    if (c == '\\')
+                    {
+                        ++i;
+                    }
+                    else if (c == '\n' && !triple_quoted)
+                    {
+                        quote = '\0';
+                    }
+                    else if (c == quote)
+                    {
+                        if (!triple_quoted)
+                        {
+                            quote = '\0';
+                        }
+                        else if (i + 2 < cursor && code[i + 1] == quote && code[i + 2] == quote)
+                        {
+                            quote = '\0';
+                            i += 2;
+                        }
+                    }
+                    continue;
+                }
+
+                if (is_identifier_char(c) && (i == 0 || !is_identifier_char(code[i - 1])))
+                {
+                    std::size_t end = i;
+                    while (end < cursor && is_identifier_char(code[end]))
+                    {
+                        ++end;
+                    }
+                    if (!std::isdigit(static_cast<unsigned char>(c)) && (i == 0 || code[i - 1] != '.'))
+                    {
+                        context.m_names.emplace_back(i, end);
+                    }
+                    i = end - 1;
+                    continue;
+                }
+
+                switch (c)
+                {
+                case '#':
+                    context.m_in_comment = true;
+                    break;
+                case '\'':
+                case '"':
+                    quote = c;
+                    triple_quoted = i + 2 < cursor && code[i + 1] == c && code[i + 2] == c;
+                    if (triple_quoted)
+                    {
+                        i += 2;
+                    }
+                    break;
+                case '(':
+                    ++context.m_paren_depth;
+                    break;
+                case ')':
+                    context.m_paren_depth = std::max(context.m_paren_depth - 1, 0);
+                    break;
+                default:
+                    break;
+                }
+            }
+            context.m_in_string = quote != '\0';
+            return context;
+        }
+    }
+
+    /******************************
+     * xname_index implementation *
+     ******************************/
+
+    void xname_index::assign(std::vector<std::string> names)
+    {
+        m_names = std::move(names);
+        std::sort(m_names.begin(), m_names.end());
+        m_names.erase(std::unique(m_names.begin(), m_names.end()), m_names.end());
+    }
+
+    void xname_index::insert(const std::string& name)
+    {
+        auto it = std::lower_bound(m_names.begin(), m_names.end(), name);
+        if (it == m_names.end() || *it != name)
+        {
+            m_names.insert(it, name);
+        }
+    }
+
+    void xname_index::erase(const std::string& name)
+    {
+        auto it = std::lower_bound(m_names.begin(), m_names.end(), name);
+        if (it != m_names.end() && *it == name)
+        {
+            m_names.erase(it);
+        }
+    }
+
+    bool xname_index::contains(const std::string& name) const
+    {
+        return std::binary_search(m_names.cbegin(), m_names.cend(), name);
+    }
+
+    void xname_index::find_prefix(const std::string& prefix, std::vector<std::string>& res) const
+    {
+        for (auto it = std::lower_bound(m_names.cbegin(), m_names.cend(), prefix);
+             it != m_names.cend() && starts_with(*it, prefix); ++it)
+        {
+            res.push_back(*it);
+        }
+    }
+
+    const std::vector<std::string>& xname_index::names() const
+    {
+        return m_names;
+    }
+
+    /**********************************
+     * xname_completer implementation *
+     **********************************/
+
+    xname_completer::xname_completer(const py::object& shell, xmodule_index* module_index)
+        : m_shell(shell)
+        , p_module_index(module_index)
+        , m_dirty(true)
+    {
+        std::vector<std::string> builtins = public_names(py::module::import("keyword").attr("kwlist"));
+        std::vector<std::string> builtin_names = public_names(py::module::import("builtins").attr("__dict__"));
+        builtins.insert(builtins.end(), builtin_names.begin(), builtin_names.end());
+        m_builtins.assign(std::move(builtins));
+    }
+
+    void xname_completer::invalidate()
+    {
+        m_dirty = true;
+    }
+
+    bool xname_completer::complete(const std::string& code,
+                                   int cursor_pos,
+                                   std::vector<std::string>& matches,
+                                   int& cursor_start)
+    {
+        std::size_t cursor = utf8_offset(code, cursor_pos);
+        // Cell magics, and tokens continuing after the cursor
+        if (cursor == std::string::npos || starts_with(code, "%%")
+            || (cursor < code.size() && is_identifier_char(code[cursor])))
+        {
+            return false;
+        }
+
+        xcode_context context = scan_code(code, cursor);
+        if (context.m_in_string || context.m_in_comment)
+        {
+            return false;
+        }
+
+        std::size_t token_begin = cursor;
+        while (token_begin > context.m_line_begin && is_identifier_char(code[token_begin - 1]))
+        {
+            --token_begin;
+        }
+        std::string token = code.substr(token_begin, cursor - token_begin);
+
+        // Current line up to the token, without indentation
+        std::string line;
+        std::size_t line_start = code.find_first_not_of(" \t", context.m_line_begin);
+        if (line_start < token_begin)
+        {
+            line = code.substr(line_start, token_begin - line_start);
+        }
+
+        bool res = false;
+        if (context.m_paren_depth == 0 && is_module_statement(line))
+        {
+            res = complete_modules(token, matches);
+        }
+        else if (!token.empty() && (token[0] == '_' || std::isdigit(static_cast<unsigned char>(token[0]))))
+        {
+            return false;
+        }
+        // Magics, shell commands, help and other imports
+        else if (!line.empty() && (line[0] == '%' || line[0] == '!' || line[0] == '?'
+                                   || starts_with_word(line, "import") || starts_with_word(line, "from")))
+        {
+            return false;
+        }
+        else if (token_begin > context.m_line_begin && code[token_begin - 1] == '.')
+        {
+            std::size_t expression_begin = token_begin - 1;
+            while (expression_begin > context.m_line_begin
+                   && (is_identifier_char(code[expression_begin - 1]) || code[expression_begin - 1] == '.'))
+            {
+                --expression_begin;
+            }
+            std::string expression = code.substr(expression_begin, token_begin - 1 - expression_begin);
+            // Only chains of names, e.g. not f().x, "abc".x or 1.x
+            if (expression.empty() || expression[0] == '.' || std::isdigit(static_cast<unsigned char>(expression[0]))
+                || expression.find("..") != std::string::npos)
+            {
+                return false;
+            }
+            res = complete_attributes(expression, token, matches);
+        }
+        else
+        {
+            // jedi completes the parameters of calls, and IPython the keys of dicts
+            std::size_t previous = token_begin;
+            while (previous > context.m_line_begin && (code[previous - 1] == ' ' || code[previous - 1] == '\t'))
+            {
+                --previous;
+            }
+            bool after_bracket = previous > context.m_line_begin && code[previous - 1] == '[';
+            bool after_definition = starts_with_word(line, "def") || starts_with_word(line, "class");
+            if (token.empty() || context.m_paren_depth > 0 || after_bracket || after_definition)
+            {
+                return false;
+            }
+            // Names of the cell preceding the cursor, which may be bound
+            // before being executed (assignments, parameters, loop variables...)
+            std::vector<std::string> cell_names;
+            for (const auto& name : context.m_names)
+            {
+                if (name.second < token_begin && code.compare(name.first, token.size(), token) == 0
+                    && name.second - name.first >= token.size())
+                {
+                    cell_names.push_back(code.substr(name.first, name.second - name.first));
+                }
+            }
+            res = complete_names(token, cell_names, matches);
+        }
+
+        if (res)
+        {
+            cursor_start = cursor_pos - utf8_length(token, token.size());
+        }
+        return res;
+    }
+
+    void xname_completer::update_globals()
+    {
+        // Incremental update with the difference between the namespace and the index
+        std::vector<std::string> current = public_names(m_shell.attr("user_ns"));
+        std::sort(current.begin(), current.end());
+        current.erase(std::unique(current.begin(), current.end()), current.end());
+
+        const std::vector<std::string>& indexed = m_globals.names();
+        std::vector<std::string> added;
+        std::vector<std::string> removed;
+        std::set_difference(current.cbegin(), current.cend(), indexed.cbegin(), indexed.cend(), std::back_inserter(added));
+        std::set_difference(indexed.cbegin(), indexed.cend(), current.cbegin(), current.cend(), std::back_inserter(removed));
+
+        // Rebuilding the index is cheaper than many insertions
+        if (added.size() + removed.size() > 64)
+        {
+            m_globals.assign(std::move(current));
+        }
+        else
+        {
+            for (const auto& name : added)
+            {
+                m_globals.insert(name);
+            }
+            for (const auto& name : removed)
+            {
+                m_globals.erase(name);
+            }
+        }
+
+        // Magics may be registered by a cell, or by loading an extension
+        py::dict magics = m_shell.attr("magics_manager").attr("lsmagic")();
+        m_line_magics.assign(public_names(magics["line"]));
+        m_cell_magics.assign(public_names(magics["cell"]));
+
+        m_dirty = false;
+    }
+
+    bool xname_completer::complete_names(const std::string& token,
+                                         const std::vector<std::string>& cell_names,
+                                         std::vector<std::string>& matches)
+    {
+        if (m_dirty)
+        {
+            update_globals();
+        }
+
+        // jedi also completes the names of the cell that are not in the
+        // namespace yet, e.g. parameters and local variables
+        for (const auto& name : cell_names)
+        {
+            if (!m_globals.contains(name) && !m_builtins.contains(name))
+            {
+                return false;
+            }
+        }
+
+        matches.clear();
+        m_globals.find_prefix(token, matches);
+        m_builtins.find_prefix(token, matches);
+        sort_matches(matches);
+
+        // Magics are listed after the names, unless a name hides them
+        std::vector<std::tuple<std::string, int>> magics;
+        std::vector<std::string> line_magics;
+        std::vector<std::string> cell_magics;
+        m_line_magics.find_prefix(token, line_magics);
+        m_cell_magics.find_prefix(token, cell_magics);
+        for (const auto& name : line_magics)
+        {
+            magics.emplace_back(name, 1);
+        }
+        for (const auto& name : cell_magics)
+        {
+            magics.emplace_back(name, 2);
+        }
+        std::sort(magics.begin(), magics.end());
+        for (const auto& magic : magics)
+        {
+            const std::string& name = std::get<0>(magic);
+            if (!m_globals.contains(name) && !m_builtins.contains(name))
+            {
+                matches.push_back(std::string(static_cast<std::size_t>(std::get<1>(magic)), '%') + name);
+            }
+        }
+        return !matches.empty();
+    }
+
+    bool xname_completer::complete_attributes(const std::string& expression,
+                                              const std::string& token,
+                                              std::vector<std::string>& matches)
+    {
+        std::size_t end = expression.find('.');
+        py::dict user_ns = m_shell.attr("user_ns");
+        py::str first(expression.substr(0, end));
+        if (!user_ns.contains(first))
+        {
+            return false;
+        }
+
+        // Only modules are indexed, the attributes of other objects may change
+        // at any time and their lookup may run arbitrary code
+        py::object object = user_ns[first];
+        while (PyModule_Check(object.ptr()) && end != std::string::npos)
+        {
+            std::size_t begin = end + 1;
+            end = expression.find('.', begin);
+            std::string name = expression.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+            if (!py::hasattr(object, name.c_str()))
+            {
+                return false;
+            }
+            object = object.attr(name.c_str());
+        }
+        if (!PyModule_Check(object.ptr()))
+        {
+            return false;
+        }
+
+        std::size_t size = py::len(object.attr("__dict__"));
+        auto it = m_modules.find(expression);
+        if (it == m_modules.end() || !it->second.m_module.is(object) || it->second.m_size != size)
+        {
+            if (it == m_modules.end() && m_modules.size() >= max_indexed_modules)
+            {
+                m_modules.clear();
+            }
+            module_entry& entry = m_modules[expression];
+            entry.m_module = object;
+            entry.m_size = size;
+            entry.m_names.assign(public_names(py::module::import("builtins").attr("dir")(object)));
+            it = m_modules.find(expression);
+        }
+
+        matches.clear();
+        it->second.m_names.find_prefix(token, matches);
+        sort_matches(matches);
+        return true;
+    }
+
+    bool xname_completer::complete_modules(const std::string& token, std::vector<std::string>& matches)
+    {
+        if (p_module_index == nullptr)
+        {
+            return false;
+        }
+
+        std::vector<std::string> modules;
+        if (!p_module_index->find_prefix(token, modules))
+        {
+            return false;
+        }
+
+        // Private modules are only listed when the token starts with an underscore
+        matches.clear();
+        for (auto& module : modules)
+        {
+            if (module[0] != '_' || !token.empty())
+            {
+                matches.push_back(std::move(module));
+            }
+        }
+        sort_matches(matches);
+
+        // IPython also finds the modules whose name differs by the case
+        return !matches.empty();
+    }
+}
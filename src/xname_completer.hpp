@@ -0,0 +1,122 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_NAME_COMPLETER_HPP
+#define XPYT_NAME_COMPLETER_HPP
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "pybind11/pybind11.h"
+
+namespace py = pybind11;
+
+namespace xpyt
+{
+    class xmodule_index;
+
+    /***************
+     * xname_index *
+     ***************/
+
+    // Sorted array of names answering prefix queries with a binary search
+    class xname_index
+    {
+    public:
+
+        void assign(std::vector<std::string> names);
+        void insert(const std::string& name);
+        void erase(const std::string& name);
+        bool contains(const std::string& name) const;
+
+        // Appends the names starting with the prefix
+        void find_prefix(const std::string& prefix, std::vector<std::string>& res) const;
+
+        const std::vector<std::string>& names() const;
+
+    private:
+
+        std::vector<std::string> m_names;
+    };
+
+    /*******************
+     * xname_completer *
+     *******************/
+
+    /**
+     * Completes plain names (variables of the user, builtins, keywords and
+     * magics), attributes of modules and names of the top-level modules in
+     * import statements without running the completer of IPython, with the
+     * same matches and the same order as jedi. Any other context (strings,
+     * calls, submodules, magics, private names...) is left to IPython, as
+     * well as plain names when the cell refers to names with the same prefix
+     * that are not in the namespace, e.g. parameters and local variables.
+     *
+     * The index of the names of the user is updated with the difference
+     * between the namespace and the index at the first completion following
+     * an execution. The attributes of a module are indexed at its first
+     * completion, and indexed again when the module is rebound or when the
+     * number of its attributes changes.
+     *
+     * Must be used with the GIL held.
+     */
+    class xname_completer
+    {
+    public:
+
+        // The index of the modules is optional, it must remain valid while
+        // the completer is used
+        xname_completer(const py::object& shell, xmodule_index* module_index = nullptr);
+
+        xname_completer(const xname_completer&) = delete;
+        xname_completer& operator=(const xname_completer&) = delete;
+
+        // The namespace of the user may have changed
+        void invalidate();
+
+        // Fills the matches and the cursor start of the request and returns
+        // true if it can be answered natively.
+        bool complete(const std::string& code,
+                      int cursor_pos,
+                      std::vector<std::string>& matches,
+                      int& cursor_start);
+
+    private:
+
+        struct module_entry
+        {
+            py::object m_module;
+            std::size_t m_size;
+            xname_index m_names;
+        };
+
+        void update_globals();
+        bool complete_names(const std::string& token,
+                            const std::vector<std::string>& cell_names,
+                            std::vector<std::string>& matches);
+        bool complete_attributes(const std::string& expression,
+                                 const std::string& token,
+                                 std::vector<std::string>& matches);
+        bool complete_modules(const std::string& token, std::vector<std::string>& matches);
+
+        py::object m_shell;
+        xmodule_index* p_module_index;
+        bool m_dirty;
+        xname_index m_builtins;
+        xname_index m_globals;
+        xname_index m_line_magics;
+        xname_index m_cell_magics;
+        std::map<std::string, module_entry> m_modules;
+    };
+}
+
+#endif
@@ -0,0 +1,137 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "nlohmann/json.hpp"
+
+#include "pybind11/pybind11.h"
+
+#include "xeus-python/xstartup.hpp"
+
+#include "xpreimport.hpp"
+
+namespace nl = nlohmann;
+namespace py = pybind11;
+
+namespace xpyt
+{
+    namespace
+    {
+        // Leaves time for the shell thread to handle the requests
+        // following the kernel_info_request
+        const std::chrono::milliseconds preimport_delay(50);
+        const std::chrono::milliseconds preimport_pause(5);
+    }
+
+    py::module lazy_import(const std::string& name, const std::string& reason)
+    {
+        py::dict modules = py::module::import("sys").attr("modules");
+        if (modules.contains(name))
+        {
+            return py::reinterpret_borrow<py::module>(modules[py::str(name)]);
+        }
+
+        double start = get_startup_elapsed();
+        py::module res = py::module::import(name.c_str());
+        double duration = get_startup_elapsed() - start;
+        append_startup_info("lazy_imports", {
+            {"module", name},
+            {"reason", reason},
+            {"time", start},
+            {"duration", duration}
+        });
+        return res;
+    }
+
+    /*******************************
+     * xpreimporter implementation *
+     *******************************/
+
+    xpreimporter::xpreimporter()
+        : m_stopped(false)
+    {
+    }
+
+    xpreimporter::~xpreimporter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond.notify_all();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    void xpreimporter::start(module_list modules)
+    {
+        if (modules.empty() || m_thread.joinable())
+        {
+            return;
+        }
+        m_thread = std::thread(&xpreimporter::run, this, std::move(modules));
+    }
+
+    void xpreimporter::run(module_list modules)
+    {
+        std::chrono::milliseconds pause = preimport_delay;
+        std::size_t done = 0;
+        for (const auto& module : modules)
+        {
+            set_startup_info("preimport", {
+                {"total", modules.size()},
+                {"done", done},
+                {"current", module.first}
+            });
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_cond.wait_for(lock, pause, [this]() { return m_stopped; }))
+                {
+                    return;
+                }
+            }
+            pause = preimport_pause;
+
+            {
+                py::gil_scoped_acquire acquire;
+                try
+                {
+                    lazy_import(module.first, module.second);
+                }
+                catch (py::error_already_set& e)
+                {
+                    append_startup_info("lazy_imports", {
+                        {"module", module.first},
+                        {"reason", module.second},
+                        {"error", e.what()}
+                    });
+                }
+            }
+            ++done;
+
+            // Progress of the long imports can be followed in the report
+            write_startup_report();
+        }
+        set_startup_info("preimport", {
+            {"total", modules.size()},
+            {"done", done},
+            {"time", get_startup_elapsed()}
+        });
+        write_startup_report();
+    }
+}
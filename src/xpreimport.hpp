@@ -0,0 +1,71 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_PREIMPORT_HPP
+#define XPYT_PREIMPORT_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "pybind11/pybind11.h"
+
+namespace py = pybind11;
+
+namespace xpyt
+{
+    // Imports a dependency of the kernel that is not needed to execute the
+    // first cell. The first actual import of each module is recorded with
+    // its duration and reason in the "lazy_imports" section of the startup
+    // report. Must be called with the GIL held.
+    py::module lazy_import(const std::string& name, const std::string& reason);
+
+    /**
+     * Imports modules in a background thread once the kernel is ready, so
+     * that the requests needing them do not pay for the import. The GIL is
+     * released between two modules, and the interpreter hands it over to
+     * the shell thread every switch interval while a module is imported
+     * (except during the initialization of extension modules). An import
+     * started by a cell while the same module is being pre-imported waits
+     * for it and gets the loaded module.
+     *
+     * The progress is reported in the "preimport" section of the startup
+     * report, and the timing of each import in the "lazy_imports" section.
+     */
+    class xpreimporter
+    {
+    public:
+
+        // Module name and reason of the import
+        using module_list = std::vector<std::pair<std::string, std::string>>;
+
+        xpreimporter();
+        ~xpreimporter();
+
+        xpreimporter(const xpreimporter&) = delete;
+        xpreimporter& operator=(const xpreimporter&) = delete;
+
+        void start(module_list modules);
+
+    private:
+
+        void run(module_list modules);
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::thread m_thread;
+        bool m_stopped;
+    };
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include "pybind11/pybind11.h"
 
 #include "xeus-python/xinterpreter.hpp"
+#include "xeus-python/xinterrupt.hpp"
 #include "xeus-python/xdebugger.hpp"
 
 namespace py = pybind11;
@@ -97,4 +98,5 @@ PYBIND11_MODULE(xpython_extension, m)
 {
     m.doc() = "Xeus-python kernel launcher";
     m.def("launch", launch, py::arg("connection_filename") = "", "Launch the Jupyter kernel");
+    m.def("interrupt", xpyt::interrupt_execution, "Interrupt the code executed by the kernel");
 }
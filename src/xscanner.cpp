@@ -0,0 +1,449 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "xscanner.hpp"
+
+namespace xpyt
+{
+    namespace
+    {
+        bool is_blank(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\f' || c == '\v';
+        }
+
+        // Classic prompts (>>>, ...) and IPython prompts (In [1]:, ...:)
+        // are stripped line by line, regardless of string literals.
+        bool starts_with_prompt(const std::string& code, std::size_t pos)
+        {
+            while (pos < code.size() && is_blank(code[pos]))
+            {
+                ++pos;
+            }
+            return code.compare(pos, 3, ">>>") == 0
+                || code.compare(pos, 3, "...") == 0
+                || code.compare(pos, 4, "In [") == 0;
+        }
+
+        // Whether the character at pos, outside of string literals and
+        // comments, starts an IPython-specific syntax. last is the last
+        // significant character, '\n' when at the beginning of a line.
+        bool is_ipython_syntax(const std::string& code, std::size_t pos, char last)
+        {
+            switch (code[pos])
+            {
+            case '?':
+                // Help syntax (obj?, ?obj, obj??)
+                return true;
+            case '!':
+                // System commands (!ls, a = !ls), only != is valid Python
+                return pos + 1 == code.size() || code[pos + 1] != '=';
+            case '%':
+                // Line and cell magics (%magic, %%magic, a = %magic)
+                return last == '\n' || last == '=';
+            case ',':
+            case ';':
+            case '/':
+                // Autocall escapes
+                return last == '\n';
+            default:
+                return false;
+            }
+        }
+
+        bool is_closing_bracket(char opening, char closing)
+        {
+            return (opening == '(' && closing == ')')
+                || (opening == '[' && closing == ']')
+                || (opening == '{' && closing == '}');
+        }
+
+        // Whether the last character that is not a blank is a new line
+        bool ends_with_newline(const std::string& code)
+        {
+            for (auto it = code.rbegin(); it != code.rend(); ++it)
+            {
+                if (*it == '\n')
+                {
+                    return true;
+                }
+                if (!is_blank(*it) && *it != '\r')
+                {
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        // Indentation of the last line as computed by IPython, where a
+        // tabulation counts for four spaces
+        std::size_t last_line_indent(const std::string& code)
+        {
+            std::size_t end = code.size();
+            if (end != 0 && code[end - 1] == '\n')
+            {
+                --end;
+            }
+            std::size_t begin = end == 0 ? std::string::npos : code.rfind('\n', end - 1);
+            begin = begin == std::string::npos ? 0 : begin + 1;
+
+            std::size_t indent = 0;
+            for (std::size_t i = begin; i < end && (code[i] == ' ' || code[i] == '\t'); ++i)
+            {
+                indent += code[i] == '\t' ? 4 : 1;
+            }
+            return indent;
+        }
+    }
+
+    bool is_plain_python(const std::string& code)
+    {
+        // Leading empty lines and indentation of the first line are removed
+        if (code.empty() || is_blank(code[0]) || code[0] == '\n' || code[0] == '\r')
+        {
+            return false;
+        }
+
+        const std::size_t size = code.size();
+        char quote = '\0';
+        bool triple_quoted = false;
+        bool line_start = true;
+        // Last significant character outside of string literals and comments,
+        // '\n' when at the beginning of a line.
+        char last = '\n';
+
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (line_start && starts_with_prompt(code, i))
+            {
+                return false;
+            }
+            line_start = false;
+
+            char c = code[i];
+            if (quote != '\0')
+            {
+                if (c == '\\')
+                {
+                    ++i;
+                    line_start = i < size && code[i] == '\n';
+                }
+                else if (c == '\n')
+                {
+                    // Unterminated string literal, let IPython report the error
+                    if (!triple_quoted)
+                    {
+                        return false;
+                    }
+                    line_start = true;
+                }
+                else if (c == quote)
+                {
+                    if (!triple_quoted)
+                    {
+                        quote = '\0';
+                    }
+                    else if (i + 2 < size && code[i + 1] == quote && code[i + 2] == quote)
+                    {
+                        quote = '\0';
+                        i += 2;
+                    }
+                    last = c;
+                }
+                continue;
+            }
+
+            if (is_ipython_syntax(code, i, last))
+            {
+                return false;
+            }
+
+            switch (c)
+            {
+            case '\n':
+                line_start = true;
+                last = '\n';
+                break;
+            case ' ':
+            case '\t':
+            case '\f':
+            case '\v':
+            case '\r':
+                break;
+            case '#':
+                while (i + 1 < size && code[i + 1] != '\n')
+                {
+                    ++i;
+                }
+                break;
+            case '\'':
+            case '"':
+                quote = c;
+                triple_quoted = i + 2 < size && code[i + 1] == c && code[i + 2] == c;
+                if (triple_quoted)
+                {
+                    i += 2;
+                }
+                last = c;
+                break;
+            case '!':
+                // !=
+                ++i;
+                last = '=';
+                break;
+            default:
+                last = c;
+                break;
+            }
+        }
+
+        return quote == '\0';
+    }
+
+    code_status check_complete(const std::string& code, std::size_t& indent)
+    {
+        // Same restrictions as is_plain_python, IPython transforms the code
+        // before checking it
+        if (code.empty() || is_blank(code[0]) || code[0] == '\n' || code[0] == '\r')
+        {
+            return code_status::unknown;
+        }
+
+        const std::size_t size = code.size();
+        char quote = '\0';
+        bool triple_quoted = false;
+        bool line_start = true;
+        char last = '\n';
+        // Opening brackets that are not closed yet
+        std::string brackets;
+        // Indentation of the enclosing blocks, as tracked by the tokenizer
+        std::vector<std::size_t> indents(1, 0);
+        // Index of the physical line, and indentation of the logical line
+        std::size_t line = 0;
+        std::size_t line_indent = 0;
+        bool line_has_token = false;
+        // A backslash continues the logical line on the next physical line,
+        // which must not be empty
+        bool continued = false;
+        bool pending_continuation = false;
+        std::size_t continuation_end = 0;
+        // Last significant character outside of string literals and comments,
+        // with the indentation of its logical line and its physical line
+        char last_token = '\0';
+        std::size_t last_token_indent = 0;
+        std::size_t last_token_line = 0;
+
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            if (line_start)
+            {
+                if (starts_with_prompt(code, i))
+                {
+                    return code_status::unknown;
+                }
+                // Start of a logical line
+                if (quote == '\0' && brackets.empty() && !continued)
+                {
+                    line_indent = 0;
+                    line_has_token = false;
+                    while (i + line_indent < size && (code[i + line_indent] == ' ' || code[i + line_indent] == '\t'))
+                    {
+                        ++line_indent;
+                    }
+                }
+                continued = false;
+            }
+            line_start = false;
+
+            char c = code[i];
+            if (c == '\n')
+            {
+                ++line;
+            }
+            if (quote != '\0')
+            {
+                if (c == '\\')
+                {
+                    ++i;
+                    line_start = i < size && code[i] == '\n';
+                    line += line_start ? 1 : 0;
+                }
+                else if (c == '\n')
+                {
+                    // Unterminated string literal
+                    if (!triple_quoted)
+                    {
+                        return code_status::unknown;
+                    }
+                    line_start = true;
+                }
+                else if (c == quote)
+                {
+                    if (!triple_quoted)
+                    {
+                        quote = '\0';
+                    }
+                    else if (i + 2 < size && code[i + 1] == quote && code[i + 2] == quote)
+                    {
+                        quote = '\0';
+                        i += 2;
+                    }
+                    last = c;
+                }
+                continue;
+            }
+
+            if (is_ipython_syntax(code, i, last))
+            {
+                return code_status::unknown;
+            }
+
+            switch (c)
+            {
+            case '\n':
+                if (pending_continuation)
+                {
+                    return code_status::unknown;
+                }
+                line_start = true;
+                last = '\n';
+                continue;
+            case ' ':
+            case '\t':
+            case '\f':
+            case '\v':
+            case '\r':
+                continue;
+            case '#':
+                if (pending_continuation)
+                {
+                    return code_status::unknown;
+                }
+                while (i + 1 < size && code[i + 1] != '\n')
+                {
+                    ++i;
+                }
+                continue;
+            case '\\':
+                // Explicit line continuation, anything else is invalid
+                if (!line_has_token || (i + 1 < size && code[i + 1] != '\n'))
+                {
+                    return code_status::unknown;
+                }
+                ++i;
+                line += i < size ? 1 : 0;
+                line_start = true;
+                continued = true;
+                pending_continuation = true;
+                continuation_end = i + 1;
+                continue;
+            case '(':
+            case '[':
+            case '{':
+                brackets.push_back(c);
+                break;
+            case ')':
+            case ']':
+            case '}':
+                if (brackets.empty() || !is_closing_bracket(brackets.back(), c))
+                {
+                    return code_status::unknown;
+                }
+                brackets.pop_back();
+                break;
+            case '\'':
+            case '"':
+                quote = c;
+                triple_quoted = i + 2 < size && code[i + 1] == c && code[i + 2] == c;
+                if (triple_quoted)
+                {
+                    i += 2;
+                }
+                break;
+            case '!':
+                // !=
+                ++i;
+                c = '=';
+                break;
+            default:
+                break;
+            }
+
+            // First token of a logical line, a dedent must match an
+            // enclosing block
+            if (!line_has_token)
+            {
+                if (line_indent > indents.back())
+                {
+                    indents.push_back(line_indent);
+                }
+                while (line_indent < indents.back())
+                {
+                    indents.pop_back();
+                }
+                if (line_indent != indents.back())
+                {
+                    return code_status::unknown;
+                }
+            }
+
+            last = last_token = c;
+            last_token_indent = line_indent;
+            last_token_line = line;
+            line_has_token = true;
+            pending_continuation = false;
+        }
+
+        // Unterminated string literal
+        if (quote != '\0' && !triple_quoted)
+        {
+            return code_status::unknown;
+        }
+
+        // Blanks after a line continuation
+        if (pending_continuation && continuation_end < size)
+        {
+            return code_status::unknown;
+        }
+
+        // Multiline string or expression
+        if (quote != '\0' || !brackets.empty() || pending_continuation)
+        {
+            indent = last_line_indent(code);
+            return code_status::incomplete;
+        }
+
+        // The last statement starts a block, blank lines following it are
+        // left to IPython
+        if (last_token == ':')
+        {
+            if (line - last_token_line > (ends_with_newline(code) ? 1u : 0u))
+            {
+                return code_status::unknown;
+            }
+            indent = last_token_indent + 4;
+            return code_status::incomplete;
+        }
+
+        // More statements may follow in the block, unless the code ends
+        // with a new line
+        if (last_token_indent != 0 && !ends_with_newline(code))
+        {
+            indent = last_line_indent(code);
+            return code_status::open_block;
+        }
+
+        return code_status::complete;
+    }
+}
@@ -0,0 +1,53 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_SCANNER_HPP
+#define XPYT_SCANNER_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace xpyt
+{
+    /**
+     * Returns true if the static IPython input transformations
+     * (prompts stripping, magics, system commands, help syntax...)
+     * would leave the given code unchanged. The check is conservative:
+     * false negatives only mean that the code goes through the regular
+     * IPython transformation pipeline.
+     */
+    bool is_plain_python(const std::string& code);
+
+    enum class code_status
+    {
+        // IPython must check the code
+        unknown,
+        incomplete,
+        // The code is complete if it compiles, invalid otherwise
+        complete,
+        // The last statement is indented: the code is incomplete if it
+        // compiles, invalid otherwise
+        open_block
+    };
+
+    /**
+     * Native version of the check_complete method of the IPython input
+     * transformers for plain Python code: open brackets, multiline strings,
+     * line continuations and statements starting a block are detected
+     * without tokenizing the code. The code must still be compiled to tell
+     * complete code from invalid code. Code with IPython-specific syntax,
+     * unbalanced brackets or unterminated strings is left to IPython.
+     *
+     * The indentation of the next line is set for incomplete code.
+     */
+    code_status check_complete(const std::string& code, std::size_t& indent);
+}
+
+#endif
@@ -0,0 +1,174 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+#include "pybind11/pybind11.h"
+
+#include "xeus-python/xstartup.hpp"
+
+#include "xinternal_utils.hpp"
+
+namespace nl = nlohmann;
+namespace py = pybind11;
+
+namespace xpyt
+{
+    namespace
+    {
+        struct startup_report
+        {
+            using clock_type = std::chrono::steady_clock;
+
+            startup_report()
+                : m_origin(clock_type::now())
+                , m_start_time(std::chrono::duration<double>(
+                      std::chrono::system_clock::now().time_since_epoch()).count())
+                , m_events(nl::json::array())
+                , m_sections(nl::json::object())
+            {
+            }
+
+            clock_type::time_point m_origin;
+            double m_start_time;
+            nl::json m_events;
+            nl::json m_sections;
+            std::string m_path;
+            std::set<std::string> m_modules;
+            std::mutex m_mutex;
+        };
+
+        // The origin is the construction of the report, i.e. the first event
+        startup_report& get_startup_report_impl()
+        {
+            static startup_report report;
+            return report;
+        }
+
+        // Must be called with the GIL held
+        nl::json get_new_modules(std::set<std::string>& known_modules)
+        {
+            nl::json res = nl::json::array();
+            py::dict modules = py::module::import("sys").attr("modules");
+            for (const auto& item : modules)
+            {
+                std::string name = py::str(item.first);
+                if (known_modules.insert(name).second)
+                {
+                    res.push_back(name);
+                }
+            }
+            return res;
+        }
+    }
+
+    void mark_startup_event(const std::string& name)
+    {
+        startup_report& report = get_startup_report_impl();
+        double time = get_startup_elapsed();
+
+        bool has_gil = Py_IsInitialized() && PyGILState_Check();
+        std::lock_guard<std::mutex> lock(report.m_mutex);
+        report.m_events.push_back({{"name", name}, {"time", time}});
+        // Walking sys.modules is only worth it when the report is written
+        if (has_gil && !report.m_path.empty())
+        {
+            nl::json modules = get_new_modules(report.m_modules);
+            if (!modules.empty())
+            {
+                report.m_sections["imports"][name] = std::move(modules);
+            }
+        }
+    }
+
+    double get_startup_elapsed()
+    {
+        startup_report& report = get_startup_report_impl();
+        return std::chrono::duration<double>(startup_report::clock_type::now() - report.m_origin).count();
+    }
+
+    void set_startup_info(const std::string& key, const nl::json& value)
+    {
+        startup_report& report = get_startup_report_impl();
+        std::lock_guard<std::mutex> lock(report.m_mutex);
+        report.m_sections[key] = value;
+    }
+
+    void append_startup_info(const std::string& key, const nl::json& value)
+    {
+        startup_report& report = get_startup_report_impl();
+        std::lock_guard<std::mutex> lock(report.m_mutex);
+        report.m_sections[key].push_back(value);
+    }
+
+    nl::json get_startup_report()
+    {
+        startup_report& report = get_startup_report_impl();
+        std::lock_guard<std::mutex> lock(report.m_mutex);
+        nl::json res = report.m_sections;
+        res["start_time"] = report.m_start_time;
+        res["events"] = report.m_events;
+        return res;
+    }
+
+    void set_startup_report_path(const std::string& path)
+    {
+        startup_report& report = get_startup_report_impl();
+        std::lock_guard<std::mutex> lock(report.m_mutex);
+        report.m_path = path;
+    }
+
+    void write_startup_report()
+    {
+        startup_report& report = get_startup_report_impl();
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(report.m_mutex);
+            if (report.m_path.empty())
+            {
+                return;
+            }
+            path = report.m_path;
+        }
+
+        std::string content = get_startup_report().dump(4);
+        if (path == "-")
+        {
+            std::cerr << content << std::endl;
+        }
+        else
+        {
+            // Replaced atomically since it may be written several times
+            std::string tmp_path = path + ".tmp";
+            {
+                std::ofstream out(tmp_path, std::ios::out | std::ios::trunc);
+                out << content << std::endl;
+                if (!out)
+                {
+                    out.close();
+                    std::remove(tmp_path.c_str());
+                    return;
+                }
+            }
+            if (!replace_file(tmp_path, path))
+            {
+                std::remove(tmp_path.c_str());
+            }
+        }
+    }
+}
@@ -17,6 +17,9 @@
 #include "pybind11/functional.h"
 #include "pybind11/pybind11.h"
 
+#include "xeus-python/xmetrics.hpp"
+#include "xeus-python/xstartup.hpp"
+
 #include "xstream.hpp"
 #include "xinternal_utils.hpp"
 
@@ -60,7 +63,16 @@ namespace xpyt
 
     void xstream::write(const std::string& message)
     {
+        // Output of the modules preloaded by the zygote, before the fork of
+        // the kernel which would publish it
+        if (!is_kernel_available())
+        {
+            (m_stream_name == "stderr" ? std::cerr : std::cout) << message;
+            return;
+        }
         xeus::get_interpreter().publish_stream(m_stream_name, message);
+        add_counter("iopub_messages_total", "type=\"stream\"");
+        add_counter("iopub_bytes_total", "type=\"stream\"", static_cast<double>(message.size()));
     }
 
     void xstream::flush()
@@ -127,6 +139,8 @@ namespace xpyt
             .def("write", &xterminal_stream::write)
             .def("flush", &xterminal_stream::flush);
 
+        mark_startup_event("stream_module");
+
         return stream_module;
     }
 
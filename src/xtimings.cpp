@@ -0,0 +1,155 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+#include "xeus-python/xmetrics.hpp"
+
+#include "xtimings.hpp"
+
+namespace nl = nlohmann;
+
+namespace xpyt
+{
+    /*****************************
+     * xhistogram implementation *
+     *****************************/
+
+    namespace
+    {
+        // From 50us to 30s
+        std::vector<double> default_bounds()
+        {
+            return {
+                0.00005, 0.0001, 0.00025, 0.0005,
+                0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+                0.1, 0.25, 0.5, 1., 2.5, 5., 10., 30.
+            };
+        }
+    }
+
+    xhistogram::xhistogram()
+        : xhistogram(default_bounds())
+    {
+    }
+
+    xhistogram::xhistogram(std::vector<double> bounds)
+        : m_bounds(std::move(bounds))
+        , m_counts(m_bounds.size() + 1, 0)
+        , m_sum(0.)
+        , m_count(0)
+    {
+    }
+
+    void xhistogram::observe(double value)
+    {
+        std::size_t index = static_cast<std::size_t>(
+            std::lower_bound(m_bounds.cbegin(), m_bounds.cend(), value) - m_bounds.cbegin()
+        );
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_counts[index];
+        m_sum += value;
+        ++m_count;
+    }
+
+    xhistogram_snapshot xhistogram::snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return xhistogram_snapshot{m_bounds, m_counts, m_sum, m_count};
+    }
+
+    namespace
+    {
+        using histogram_map = std::map<std::string, xhistogram>;
+
+        histogram_map& get_histogram_map()
+        {
+            static histogram_map hm;
+            return hm;
+        }
+
+        std::mutex& get_histogram_map_mutex()
+        {
+            static std::mutex m;
+            return m;
+        }
+    }
+
+    xhistogram& get_phase_histogram(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(get_histogram_map_mutex());
+        histogram_map& hm = get_histogram_map();
+        auto it = hm.find(name);
+        if (it == hm.end())
+        {
+            it = hm.emplace(std::piecewise_construct,
+                            std::forward_as_tuple(name),
+                            std::forward_as_tuple()).first;
+        }
+        return it->second;
+    }
+
+    std::map<std::string, xhistogram_snapshot> snapshot_phase_histograms()
+    {
+        std::lock_guard<std::mutex> lock(get_histogram_map_mutex());
+        std::map<std::string, xhistogram_snapshot> res;
+        for (const auto& p : get_histogram_map())
+        {
+            res.emplace(p.first, p.second.snapshot());
+        }
+        return res;
+    }
+
+    /*******************************
+     * xphase_timer implementation *
+     *******************************/
+
+    xphase_timer::xphase_timer(std::string request_type)
+        : m_request_type(std::move(request_type))
+        , m_start(clock_type::now())
+        , m_last(m_start)
+    {
+        add_counter("requests_total", "type=\"" + m_request_type + '"');
+    }
+
+    xphase_timer::~xphase_timer()
+    {
+        get_phase_histogram(m_request_type).observe(std::chrono::duration<double>(m_last - m_start).count());
+    }
+
+    void xphase_timer::mark(const std::string& phase)
+    {
+        clock_type::time_point now = clock_type::now();
+        double duration = std::chrono::duration<double>(now - m_last).count();
+        m_last = now;
+        m_phases.emplace_back(phase, duration);
+        get_phase_histogram(m_request_type + '.' + phase).observe(duration);
+    }
+
+    nl::json xphase_timer::to_json() const
+    {
+        nl::json res = nl::json::object();
+        for (const auto& p : m_phases)
+        {
+            res[p.first] = p.second;
+        }
+        res["total"] = std::chrono::duration<double>(m_last - m_start).count();
+        return res;
+    }
+}
@@ -0,0 +1,102 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_TIMINGS_HPP
+#define XPYT_TIMINGS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace nl = nlohmann;
+
+namespace xpyt
+{
+    /***********************
+     * xhistogram_snapshot *
+     ***********************/
+
+    struct xhistogram_snapshot
+    {
+        // Upper bounds of the buckets, the last (implicit) bucket is +Inf
+        std::vector<double> m_bounds;
+        // Non cumulative counts, m_counts.size() == m_bounds.size() + 1
+        std::vector<std::uint64_t> m_counts;
+        double m_sum;
+        std::uint64_t m_count;
+    };
+
+    /**************
+     * xhistogram *
+     **************/
+
+    // Thread-safe histogram of durations expressed in seconds.
+    class xhistogram
+    {
+    public:
+
+        xhistogram();
+        explicit xhistogram(std::vector<double> bounds);
+
+        xhistogram(const xhistogram&) = delete;
+        xhistogram& operator=(const xhistogram&) = delete;
+
+        void observe(double value);
+        xhistogram_snapshot snapshot() const;
+
+    private:
+
+        std::vector<double> m_bounds;
+        std::vector<std::uint64_t> m_counts;
+        double m_sum;
+        std::uint64_t m_count;
+        mutable std::mutex m_mutex;
+    };
+
+    // Histograms are registered by name, e.g. "execute.run_cell"
+    xhistogram& get_phase_histogram(const std::string& name);
+    std::map<std::string, xhistogram_snapshot> snapshot_phase_histograms();
+
+    /****************
+     * xphase_timer *
+     ****************/
+
+    // Measures consecutive phases of a request. Each call to mark() ends
+    // the current phase, records its duration in the corresponding phase
+    // histogram and starts the next one. The total duration of the request
+    // is recorded upon destruction.
+    class xphase_timer
+    {
+    public:
+
+        using clock_type = std::chrono::steady_clock;
+
+        explicit xphase_timer(std::string request_type);
+        ~xphase_timer();
+
+        void mark(const std::string& phase);
+        nl::json to_json() const;
+
+    private:
+
+        std::string m_request_type;
+        clock_type::time_point m_start;
+        clock_type::time_point m_last;
+        std::vector<std::pair<std::string, double>> m_phases;
+    };
+}
+
+#endif
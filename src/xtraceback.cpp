@@ -8,32 +8,405 @@
 * The full license is in the file LICENSE, distributed with this software. *
 ****************************************************************************/
 
+#include <cstddef>
 #include <map>
 #include <vector>
 #include <sstream>
 #include <string>
+#include <utility>
 
 #include "xeus-python/xutils.hpp"
+#include "xeus-python/xstartup.hpp"
 #include "xeus-python/xtraceback.hpp"
 
 #include "pybind11/pybind11.h"
 
+#include "frameobject.h"
+
+#include "xcode_cache.hpp"
 #include "xinternal_utils.hpp"
+#include "xpreimport.hpp"
 
 namespace py = pybind11;
 
 namespace xpyt
 {
+    namespace
+    {
+        // Separator of the lines highlighted in a single call. It resets the
+        // state of the lexer after keywords expecting a name (def, import...)
+        const std::string batch_separator = "\n;\n";
+
+        struct xhighlighter
+        {
+            py::object m_highlight;
+            py::object m_lexer;
+            py::object m_formatter;
+        };
+
+        // The lexer and the formatter are created once, and intentionally
+        // leaked: they must outlive static destructors which run after
+        // Py_Finalize.
+        xhighlighter* make_highlighter()
+        {
+            py::object py_highlight = lazy_import("pygments", "traceback highlighting").attr("highlight");
+            // py::module::import("pygments").attr("formatters") does NOT work due
+            // to side effects when importing pygments
+            py::object formatter = lazy_import("pygments.formatters", "traceback highlighting").attr("TerminalFormatter");
+            py::object lexer = lazy_import("pygments.lexers", "traceback highlighting").attr("Python3Lexer");
+            return new xhighlighter{py_highlight, lexer(), formatter()};
+        }
+
+        xhighlighter& get_highlighter()
+        {
+            static xhighlighter* highlighter = make_highlighter();
+            return *highlighter;
+        }
+
+        // Whether the line leaves the lexer in its initial state, i.e. it does
+        // not open a string literal nor continue on the next line
+        bool is_self_contained(const std::string& line)
+        {
+            if (line.empty() || line.back() == '\\' || line.find_first_of("\r\n") != std::string::npos
+                || line.find("\"\"\"") != std::string::npos || line.find("\'\'\'") != std::string::npos)
+            {
+                return false;
+            }
+
+            char quote = '\0';
+            for (std::size_t i = 0; i < line.size(); ++i)
+            {
+                char c = line[i];
+                if (quote != '\0')
+                {
+                    if (c == '\\')
+                    {
+                        ++i;
+                    }
+                    else if (c == quote)
+                    {
+                        quote = '\0';
+                    }
+                }
+                else if (c == '#')
+                {
+                    break;
+                }
+                else if (c == '\'' || c == '"')
+                {
+                    quote = c;
+                }
+            }
+            return quote == '\0';
+        }
+    }
+
     std::string highlight(const std::string& code)
     {
-        py::object py_highlight = py::module::import("pygments").attr("highlight");
-        // py::module::import("pygments").attr("formatters") does NOT work due
-        // to side effects when importing pygments
-        py::object formatter = py::module::import("pygments.formatters").attr("TerminalFormatter");
+        xhighlighter& highlighter = get_highlighter();
+        return py::str(highlighter.m_highlight(code, highlighter.m_lexer, highlighter.m_formatter));
+    }
+
+    std::vector<std::string> highlight_lines(const std::vector<std::string>& lines)
+    {
+        // Each distinct line is highlighted once, e.g. in the frames of a deep
+        // recursion, and the self-contained lines are highlighted together
+        std::map<std::string, std::string> highlighted;
+        std::vector<std::string> batched;
+        std::string batch;
+        for (const auto& line : lines)
+        {
+            if (highlighted.find(line) != highlighted.end())
+            {
+                continue;
+            }
+            if (is_self_contained(line))
+            {
+                highlighted[line];
+                batch += batched.empty() ? line : batch_separator + line;
+                batched.push_back(line);
+            }
+            else
+            {
+                highlighted[line] = highlight(line);
+            }
+        }
 
-        py::object lexer = py::module::import("pygments.lexers").attr("Python3Lexer");
+        if (!batched.empty())
+        {
+            // Every other line of the result is a separator
+            std::vector<std::string> result_lines;
+            std::istringstream result(highlight(batch));
+            std::string result_line;
+            while (std::getline(result, result_line))
+            {
+                result_lines.push_back(result_line);
+            }
+
+            bool aligned = result_lines.size() == 2 * batched.size() - 1;
+            for (std::size_t i = 0; i < batched.size(); ++i)
+            {
+                highlighted[batched[i]] = aligned ? result_lines[2 * i] + '\n' : highlight(batched[i]);
+            }
+        }
 
-        return py::str(py_highlight(code, lexer(), formatter()));
+        std::vector<std::string> res;
+        res.reserve(lines.size());
+        for (const auto& line : lines)
+        {
+            res.push_back(highlighted[line]);
+        }
+        return res;
+    }
+
+    namespace
+    {
+        struct xframe_info
+        {
+            // Owned by the traceback
+            PyFrameObject* p_frame;
+            std::string m_filename;
+            std::string m_name;
+            int m_lineno;
+        };
+
+        std::string to_utf8(PyObject* str)
+        {
+            if (str == nullptr)
+            {
+                return "";
+            }
+            Py_ssize_t size = 0;
+            const char* data = PyUnicode_Check(str) ? PyUnicode_AsUTF8AndSize(str, &size) : nullptr;
+            if (data == nullptr)
+            {
+                // Not a string, or lone surrogates in a file name
+                PyErr_Clear();
+                py::str repr(py::handle(str));
+                return repr.attr("encode")("utf-8", "backslashreplace").cast<std::string>();
+            }
+            return std::string(data, static_cast<std::size_t>(size));
+        }
+
+        // Walks the traceback with the C API, rather than with
+        // traceback.extract_tb which builds a FrameSummary and reads the
+        // source line of each frame
+        std::vector<xframe_info> walk_traceback(const py::object& traceback)
+        {
+            std::vector<xframe_info> frames;
+            PyObject* tb = traceback.ptr();
+            while (tb != nullptr && PyTraceBack_Check(tb))
+            {
+                PyTracebackObject* tb_object = reinterpret_cast<PyTracebackObject*>(tb);
+                PyFrameObject* frame = tb_object->tb_frame;
+#if PY_VERSION_HEX >= 0x03090000
+                py::object code = py::reinterpret_steal<py::object>(reinterpret_cast<PyObject*>(PyFrame_GetCode(frame)));
+#else
+                py::object code = py::reinterpret_borrow<py::object>(reinterpret_cast<PyObject*>(frame->f_code));
+#endif
+                PyCodeObject* code_object = reinterpret_cast<PyCodeObject*>(code.ptr());
+
+                // The line number is computed lazily since Python 3.11
+                int lineno = tb_object->tb_lineno;
+                if (lineno < 0)
+                {
+                    lineno = PyCode_Addr2Line(code_object, tb_object->tb_lasti);
+                }
+
+                frames.push_back({frame, to_utf8(code_object->co_filename), to_utf8(code_object->co_name), lineno});
+                tb = reinterpret_cast<PyObject*>(tb_object->tb_next);
+            }
+            return frames;
+        }
+
+        // Source lines of the frames, stripped, read through linecache like
+        // traceback.extract_tb does. Each distinct location is read once.
+        std::vector<std::string> read_lines(const std::vector<xframe_info>& frames)
+        {
+            py::module linecache = py::module::import("linecache");
+            std::map<std::string, std::map<int, std::string>> files;
+            std::vector<std::string> lines;
+            lines.reserve(frames.size());
+            for (const auto& frame : frames)
+            {
+                auto file = files.find(frame.m_filename);
+                if (file == files.end())
+                {
+                    // Drops the cached lines of a file modified since it was
+                    // cached, as traceback.extract_tb does
+                    linecache.attr("checkcache")(frame.m_filename);
+                    // Sources provided by the loader of the module, e.g. in a zip file
+                    linecache.attr("lazycache")(frame.m_filename, py::handle(reinterpret_cast<PyObject*>(frame.p_frame)).attr("f_globals"));
+                    file = files.emplace(frame.m_filename, std::map<int, std::string>()).first;
+                }
+
+                auto line = file->second.find(frame.m_lineno);
+                if (line == file->second.end())
+                {
+                    py::object source = linecache.attr("getline")(frame.m_filename, frame.m_lineno);
+                    line = file->second.emplace(frame.m_lineno, py::str(source.attr("strip")())).first;
+                }
+                lines.push_back(line->second);
+            }
+            return lines;
+        }
+
+        // A displayed frame, or a marker standing for frames that are not
+        // displayed
+        struct xframe_entry
+        {
+            std::size_t m_frame;
+            std::string m_marker;
+            // Number of frames the entry stands for
+            std::size_t m_count;
+        };
+
+        // Repeated sequences of up to max_repeated_period frames are collapsed
+        // when they occur at least min_repetitions times in a row
+        const std::size_t max_repeated_period = 16;
+        const std::size_t min_repetitions = 3;
+
+        bool same_frames(const std::vector<xframe_info>& frames, std::size_t lhs, std::size_t rhs, std::size_t size)
+        {
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                const xframe_info& lhs_frame = frames[lhs + i];
+                const xframe_info& rhs_frame = frames[rhs + i];
+                if (lhs_frame.m_lineno != rhs_frame.m_lineno
+                    || lhs_frame.m_name != rhs_frame.m_name
+                    || lhs_frame.m_filename != rhs_frame.m_filename)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::vector<xframe_entry> collapse_frames(const std::vector<xframe_info>& frames)
+        {
+            std::vector<xframe_entry> entries;
+            std::size_t i = 0;
+            while (i < frames.size())
+            {
+                // Shortest sequence starting at this frame that repeats
+                std::size_t period = 0;
+                std::size_t repetitions = 0;
+                for (std::size_t size = 1; size <= max_repeated_period && i + size * min_repetitions <= frames.size(); ++size)
+                {
+                    std::size_t count = 1;
+                    while (i + (count + 1) * size <= frames.size() && same_frames(frames, i, i + count * size, size))
+                    {
+                        ++count;
+                    }
+                    if (count >= min_repetitions)
+                    {
+                        period = size;
+                        repetitions = count;
+                        break;
+                    }
+                }
+
+                if (period == 0)
+                {
+                    entries.push_back({i, "", 1});
+                    ++i;
+                    continue;
+                }
+
+                for (std::size_t j = 0; j < period; ++j)
+                {
+                    entries.push_back({i + j, "", 1});
+                }
+                std::string marker = period == 1
+                    ? "[Previous frame repeated " + std::to_string(repetitions - 1) + " times]"
+                    : "[Previous " + std::to_string(period) + " frames repeated " + std::to_string(repetitions - 1) + " times]";
+                entries.push_back({0, marker, period * (repetitions - 1)});
+                i += period * repetitions;
+            }
+            return entries;
+        }
+
+        // Keeps the first and the last frames, the frames in between are
+        // replaced with a marker
+        void limit_frames(std::vector<xframe_entry>& entries, std::size_t max_frames)
+        {
+            std::size_t displayed = 0;
+            for (const auto& entry : entries)
+            {
+                displayed += entry.m_marker.empty() ? 1 : 0;
+            }
+            if (max_frames == 0 || displayed <= max_frames)
+            {
+                return;
+            }
+
+            // Entries before begin and from end on are kept
+            std::size_t head = max_frames / 2;
+            std::size_t begin = 0;
+            for (std::size_t count = 0; count < head; ++begin)
+            {
+                count += entries[begin].m_marker.empty() ? 1 : 0;
+            }
+            std::size_t tail = max_frames - head;
+            std::size_t end = entries.size();
+            for (std::size_t count = 0; count < tail; --end)
+            {
+                count += entries[end - 1].m_marker.empty() ? 1 : 0;
+            }
+
+            std::size_t omitted = 0;
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                omitted += entries[i].m_count;
+            }
+            entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(begin) + 1, entries.begin() + static_cast<std::ptrdiff_t>(end));
+            std::string marker = omitted == 1 ? "[1 frame omitted]" : "[" + std::to_string(omitted) + " frames omitted]";
+            entries[begin] = {0, marker, omitted};
+        }
+
+        // Truncates the line to max_length characters (UTF-8 code points)
+        std::string truncate_line(const std::string& line, std::size_t max_length)
+        {
+            if (max_length == 0 || line.size() <= max_length)
+            {
+                return line;
+            }
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < line.size(); ++i)
+            {
+                if ((static_cast<unsigned char>(line[i]) & 0xC0) != 0x80)
+                {
+                    if (count == max_length)
+                    {
+                        return line.substr(0, i) + "...";
+                    }
+                    ++count;
+                }
+            }
+            return line;
+        }
+
+        std::string truncate_lines(const std::string& text, std::size_t max_length)
+        {
+            if (max_length == 0 || text.size() <= max_length)
+            {
+                return text;
+            }
+            std::string res;
+            std::size_t begin = 0;
+            while (begin <= text.size())
+            {
+                std::size_t end = text.find('\n', begin);
+                res += truncate_line(text.substr(begin, end == std::string::npos ? std::string::npos : end - begin), max_length);
+                if (end == std::string::npos)
+                {
+                    break;
+                }
+                res += '\n';
+                begin = end + 1;
+            }
+            return res;
+        }
     }
 
     std::string extract_line(const std::string& code, std::size_t lineno)
@@ -73,7 +446,10 @@ namespace xpyt
         get_filename_map()[filename] = execution_count;
     }
 
-    xerror extract_error(const py::object& type, const py::object& value, const py::object& traceback)
+    xerror extract_error(const py::object& type,
+                         const py::object& value,
+                         const py::object& traceback,
+                         const xtraceback_limits& limits)
     {
         xerror out;
 
@@ -86,7 +462,7 @@ namespace xpyt
         else
         {
             out.m_ename = py::str(type.attr("__name__"));
-            out.m_evalue = py::str(value);
+            out.m_evalue = truncate_lines(py::str(value), limits.m_max_line_length);
 
             std::size_t first_frame_size(75);
             std::string delimiter(first_frame_size, '-');
@@ -100,30 +476,56 @@ namespace xpyt
 
             if (traceback.ptr() != nullptr && !traceback.is_none())
             {
-                for (py::handle py_frame : py::module::import("traceback").attr("extract_tb")(traceback))
+                std::vector<xframe_info> frames;
+                for (auto& frame : walk_traceback(traceback))
                 {
-                    std::string filename;
-                    std::string lineno;
-                    std::string name;
-                    std::string line;
+                    // Workaround for py::exec, and frames of the code embedded in the kernel
+                    if (frame.m_filename == "<string>" || frame.m_filename.compare(0, 9, "<xpython-") == 0)
+                    {
+                        continue;
+                    }
+                    frames.push_back(std::move(frame));
+                }
+
+                // Repeated frames, e.g. of a recursion, are displayed once
+                std::vector<xframe_entry> entries = collapse_frames(frames);
+                limit_frames(entries, limits.m_max_frames);
 
-                    filename = py::str(py_frame.attr("filename"));
-                    lineno = py::str(py_frame.attr("lineno"));
-                    name = py::str(py_frame.attr("name"));
-                    line = py::str(py_frame.attr("line"));
+                // Only the lines of the displayed frames are read, and they
+                // are highlighted at once
+                std::vector<xframe_info> displayed;
+                for (const auto& entry : entries)
+                {
+                    if (entry.m_marker.empty())
+                    {
+                        displayed.push_back(frames[entry.m_frame]);
+                    }
+                }
+                std::vector<std::string> lines = read_lines(displayed);
+                for (auto& line : lines)
+                {
+                    line = truncate_line(line, limits.m_max_line_length);
+                }
+                std::vector<std::string> highlighted = highlight_lines(lines);
 
-                    // Workaround for py::exec
-                    if (filename == "<string>")
+                std::string prefix = get_tmp_prefix();
+                std::size_t i = 0;
+                for (const auto& entry : entries)
+                {
+                    if (!entry.m_marker.empty())
                     {
+                        out.m_traceback.push_back(entry.m_marker);
                         continue;
                     }
 
+                    std::string filename = displayed[i].m_filename;
+                    std::string lineno = displayed[i].m_lineno < 0 ? "None" : std::to_string(displayed[i].m_lineno);
+
                     std::stringstream cpp_frame;
                     std::string padding(6 - lineno.size(), ' ');
                     std::string file_prefix;
                     std::string func_name;
 
-                    std::string prefix = get_tmp_prefix();
                     // If the error occured in a cell code, extract the line from the given code
                     if(!filename.empty() && !filename.compare(0, prefix.size(), prefix.c_str(), prefix.size()))
                     {
@@ -137,13 +539,14 @@ namespace xpyt
                     else
                     {
                         file_prefix = "File ";
-                        func_name = ", in " + green_text(name);
+                        func_name = ", in " + green_text(displayed[i].m_name);
                     }
 
                     cpp_frame << file_prefix << blue_text(filename) << func_name << ":\n"
                             << "Line " << blue_text(lineno) << ":"
-                            << padding << highlight(line);
+                            << padding << highlighted[i];
                     out.m_traceback.push_back(cpp_frame.str());
+                    ++i;
                 }
             }
 
@@ -156,9 +559,19 @@ namespace xpyt
         return out;
     }
 
+    xerror extract_error(py::error_already_set& error, const xtraceback_limits& limits)
+    {
+        return extract_error(error.type(), error.value(), error.trace(), limits);
+    }
+
     xerror extract_error(py::error_already_set& error)
     {
-        return extract_error(error.type(), error.value(), error.trace());
+        return extract_error(error, xtraceback_limits());
+    }
+
+    xerror extract_error(const py::object& type, const py::object& value, const py::object& traceback)
+    {
+        return extract_error(type, value, traceback, xtraceback_limits());
     }
 
     /********************
@@ -175,7 +588,7 @@ namespace xpyt
             py::arg("execution_count")
         );
 
-        exec(py::str(R"(
+        exec_cached("traceback_module", R"(
 last_error = None
 
 
@@ -195,7 +608,9 @@ def get_last_error():
     global last_error
 
     return last_error
-        )"), traceback_module.attr("__dict__"));
+        )", traceback_module.attr("__dict__"));
+
+        mark_startup_event("traceback_module");
 
         return traceback_module;
     }
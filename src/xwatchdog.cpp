@@ -0,0 +1,222 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+#include "pybind11/pybind11.h"
+
+#include "xinternal_utils.hpp"
+#include "xwatchdog.hpp"
+
+namespace nl = nlohmann;
+namespace py = pybind11;
+
+namespace xpyt
+{
+    bool xresource_limits::empty() const
+    {
+        return m_wall_time <= 0. && m_cpu_time <= 0. && m_memory_growth == 0;
+    }
+
+    namespace
+    {
+        // The class is defined in a module registered in sys.modules, so
+        // that it can be imported and its instances pickled
+        PyObject* make_kernel_resource_error()
+        {
+            PyObject* exception_type = PyErr_NewExceptionWithDoc(
+                "xpython_resources.KernelResourceError",
+                "Raised when a cell exceeds one of the resource limits of the kernel.",
+                PyExc_BaseException,
+                nullptr
+            );
+            if (exception_type == nullptr)
+            {
+                throw py::error_already_set();
+            }
+
+            py::module resources_module = create_module("xpython_resources");
+            resources_module.attr("KernelResourceError") = py::handle(exception_type);
+            py::module::import("sys").attr("modules")["xpython_resources"] = resources_module;
+            return exception_type;
+        }
+    }
+
+    py::object get_kernel_resource_error()
+    {
+        // Intentionally leaked, the class must outlive the watchdog thread
+        static PyObject* exception_type = make_kernel_resource_error();
+        return py::reinterpret_borrow<py::object>(exception_type);
+    }
+
+    /****************************
+     * xwatchdog implementation *
+     ****************************/
+
+    xwatchdog::xwatchdog()
+        : m_stopped(false)
+        , m_armed(false)
+        , m_fired(false)
+        , m_thread_ident(0)
+        , m_start_cpu_time(0.)
+        , m_start_memory(0)
+    {
+        // Ensures the exception type is created with the GIL held
+        get_kernel_resource_error();
+    }
+
+    xwatchdog::~xwatchdog()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond.notify_all();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    void xwatchdog::arm(const xresource_limits& limits)
+    {
+        if (limits.empty())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_armed = true;
+        m_fired = false;
+        m_thread_ident = PyThread_get_thread_ident();
+        m_limits = limits;
+        m_start_time = clock_type::now();
+        m_start_cpu_time = get_cpu_time();
+        m_start_memory = get_resident_memory();
+        m_violation = nullptr;
+
+        // The thread is only started when limits are actually used
+        if (!m_thread.joinable())
+        {
+            m_thread = std::thread(&xwatchdog::run, this);
+        }
+        m_cond.notify_all();
+    }
+
+    nl::json xwatchdog::disarm()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_armed)
+        {
+            return nullptr;
+        }
+        m_armed = false;
+        if (m_fired)
+        {
+            // Cancels the exception if it has not been raised yet
+            PyThreadState_SetAsyncExc(m_thread_ident, nullptr);
+        }
+        return m_violation;
+    }
+
+    void xwatchdog::run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopped)
+        {
+            if (!m_armed || m_fired)
+            {
+                m_cond.wait(lock);
+                continue;
+            }
+
+            // Checks every 50ms, or earlier for short time limits
+            double interval = 0.05;
+            if (m_limits.m_wall_time > 0.)
+            {
+                interval = std::min(interval, m_limits.m_wall_time / 10.);
+            }
+            m_cond.wait_for(lock, std::chrono::duration<double>(interval));
+            if (m_stopped || !m_armed || m_fired)
+            {
+                continue;
+            }
+
+            nl::json violation = check_limits();
+            if (violation.is_null())
+            {
+                continue;
+            }
+
+            // The GIL must be acquired before the mutex, as in arm and disarm
+            unsigned long thread_ident = m_thread_ident;
+            lock.unlock();
+            PyGILState_STATE gil_state = PyGILState_Ensure();
+            lock.lock();
+            if (m_armed && !m_fired && m_thread_ident == thread_ident)
+            {
+                PyThreadState_SetAsyncExc(thread_ident, get_kernel_resource_error().ptr());
+                m_fired = true;
+                m_violation = std::move(violation);
+            }
+            lock.unlock();
+            PyGILState_Release(gil_state);
+            lock.lock();
+        }
+    }
+
+    nl::json xwatchdog::check_limits() const
+    {
+        auto make_violation = [](const char* resource, double limit, double value)
+        {
+            return nl::json::object({
+                {"resource", resource},
+                {"limit", limit},
+                {"value", value}
+            });
+        };
+
+        if (m_limits.m_wall_time > 0.)
+        {
+            double wall_time = std::chrono::duration<double>(clock_type::now() - m_start_time).count();
+            if (wall_time > m_limits.m_wall_time)
+            {
+                return make_violation("wall_time", m_limits.m_wall_time, wall_time);
+            }
+        }
+
+        if (m_limits.m_cpu_time > 0.)
+        {
+            double cpu_time = get_cpu_time() - m_start_cpu_time;
+            if (cpu_time > m_limits.m_cpu_time)
+            {
+                return make_violation("cpu_time", m_limits.m_cpu_time, cpu_time);
+            }
+        }
+
+        if (m_limits.m_memory_growth != 0)
+        {
+            std::size_t memory = get_resident_memory();
+            if (memory > m_start_memory && memory - m_start_memory > m_limits.m_memory_growth)
+            {
+                return make_violation("memory_growth",
+                                      static_cast<double>(m_limits.m_memory_growth),
+                                      static_cast<double>(memory - m_start_memory));
+            }
+        }
+
+        return nullptr;
+    }
+}
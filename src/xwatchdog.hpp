@@ -0,0 +1,92 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_WATCHDOG_HPP
+#define XPYT_WATCHDOG_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+#include "nlohmann/json.hpp"
+
+#include "pybind11/pybind11.h"
+
+namespace nl = nlohmann;
+namespace py = pybind11;
+
+namespace xpyt
+{
+    // A null limit means no limit
+    struct xresource_limits
+    {
+        double m_wall_time = 0.;
+        double m_cpu_time = 0.;
+        std::size_t m_memory_growth = 0;
+
+        bool empty() const;
+    };
+
+    /**
+     * Watches the resources used by the execution of a cell and raises a
+     * KernelResourceError in the executing thread when a limit is exceeded.
+     * The exception is raised asynchronously, i.e. at the next bytecode
+     * boundary of the executing thread: a thread blocked in a system call
+     * or in native code is only interrupted when it returns to Python.
+     *
+     * arm() and disarm() must be called with the GIL held, from the thread
+     * executing the cell.
+     */
+    class xwatchdog
+    {
+    public:
+
+        xwatchdog();
+        ~xwatchdog();
+
+        xwatchdog(const xwatchdog&) = delete;
+        xwatchdog& operator=(const xwatchdog&) = delete;
+
+        void arm(const xresource_limits& limits);
+
+        // Returns a description of the exceeded limit, or null
+        nl::json disarm();
+
+    private:
+
+        using clock_type = std::chrono::steady_clock;
+
+        void run();
+        nl::json check_limits() const;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::thread m_thread;
+        bool m_stopped;
+
+        bool m_armed;
+        bool m_fired;
+        unsigned long m_thread_ident;
+        xresource_limits m_limits;
+        clock_type::time_point m_start_time;
+        double m_start_cpu_time;
+        std::size_t m_start_memory;
+        nl::json m_violation;
+    };
+
+    // The KernelResourceError exception class, derived from BaseException
+    // so that it is not swallowed by "except Exception" clauses. It is
+    // defined in the xpython_resources module.
+    py::object get_kernel_resource_error();
+}
+
+#endif
@@ -0,0 +1,503 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#include "pybind11/embed.h"
+#include "pybind11/pybind11.h"
+
+#include "xeus-python/xstartup.hpp"
+
+#include "xcomm.hpp"
+#include "xinternal_utils.hpp"
+#include "xzygote.hpp"
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+namespace xpyt
+{
+    void detach_kernel()
+    {
+        set_kernel_available(false);
+    }
+
+    void attach_kernel()
+    {
+        if (!is_kernel_available())
+        {
+            set_kernel_available(true);
+            py::gil_scoped_acquire acquire;
+            register_deferred_comm_targets();
+        }
+    }
+
+#ifndef _WIN32
+    namespace
+    {
+        bool make_address(const std::string& socket_path, sockaddr_un& address)
+        {
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (socket_path.size() >= sizeof(address.sun_path))
+            {
+                std::clog << "Zygote socket path is too long: " << socket_path << std::endl;
+                return false;
+            }
+            std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+            return true;
+        }
+
+        bool read_line(int fd, std::string& line)
+        {
+            line.clear();
+            char c;
+            while (line.size() < 4096)
+            {
+                ssize_t res = ::read(fd, &c, 1);
+                if (res < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (res <= 0)
+                {
+                    return false;
+                }
+                if (c == '\n')
+                {
+                    return true;
+                }
+                line += c;
+            }
+            return false;
+        }
+
+        bool write_all(int fd, const std::string& data)
+        {
+            std::size_t written = 0;
+            while (written < data.size())
+            {
+                ssize_t res = ::write(fd, data.data() + written, data.size() - written);
+                if (res < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (res <= 0)
+                {
+                    return false;
+                }
+                written += static_cast<std::size_t>(res);
+            }
+            return true;
+        }
+
+        void write_line(int fd, const std::string& line)
+        {
+            write_all(fd, line + '\n');
+        }
+
+        bool read_all(int fd, std::size_t size, std::string& data)
+        {
+            data.assign(size, '\0');
+            std::size_t read = 0;
+            while (read < size)
+            {
+                ssize_t res = ::read(fd, &data[read], size - read);
+                if (res < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (res <= 0)
+                {
+                    return false;
+                }
+                read += static_cast<std::size_t>(res);
+            }
+            return true;
+        }
+
+        // Only the user running the zygote may have kernels forked
+        bool is_same_user(int fd)
+        {
+#if defined(__linux__)
+            ucred credentials;
+            socklen_t size = sizeof(credentials);
+            if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) < 0)
+            {
+                return false;
+            }
+            uid_t uid = credentials.uid;
+#else
+            uid_t uid;
+            gid_t gid;
+            if (::getpeereid(fd, &uid, &gid) < 0)
+            {
+                return false;
+            }
+#endif
+            return uid == ::geteuid();
+        }
+
+        // Maximum size of the environment sent by a client
+        const std::size_t max_environment_size = 1024 * 1024;
+
+        // The working directory and the environment of the client, which
+        // replace the ones of the zygote in the kernel
+        struct client_context
+        {
+            std::string m_cwd;
+            std::vector<std::string> m_environment;
+        };
+
+        bool read_context(int fd, client_context& context)
+        {
+            std::string size;
+            std::string environment;
+            if (!read_line(fd, context.m_cwd) || !read_line(fd, size))
+            {
+                return false;
+            }
+            char* end = nullptr;
+            unsigned long long environment_size = std::strtoull(size.c_str(), &end, 10);
+            if (size.empty() || *end != '\0' || environment_size > max_environment_size
+                || !read_all(fd, static_cast<std::size_t>(environment_size), environment))
+            {
+                return false;
+            }
+
+            // NUL-separated KEY=VALUE entries
+            std::size_t begin = 0;
+            while (begin < environment.size())
+            {
+                std::size_t entry_end = environment.find('\0', begin);
+                if (entry_end == std::string::npos)
+                {
+                    entry_end = environment.size();
+                }
+                std::size_t separator = environment.find('=', begin);
+                if (separator != begin && separator < entry_end)
+                {
+                    context.m_environment.push_back(environment.substr(begin, entry_end - begin));
+                }
+                begin = entry_end + 1;
+            }
+            return true;
+        }
+
+        bool write_context(int fd)
+        {
+            std::string cwd(4096, '\0');
+            if (::getcwd(&cwd[0], cwd.size()) == nullptr)
+            {
+                return false;
+            }
+            cwd.resize(std::strlen(cwd.c_str()));
+
+            std::string environment;
+            for (char** entry = environ; *entry != nullptr; ++entry)
+            {
+                environment += *entry;
+                environment += '\0';
+            }
+            return write_all(fd, cwd + '\n' + std::to_string(environment.size()) + '\n' + environment);
+        }
+
+        // Threads do not survive a fork, and the history database connection
+        // must not be shared between processes: the saving thread is stopped
+        // in the zygote and restarted with a new session in each kernel.
+        void prepare_fork()
+        {
+            exec(py::str(R"(
+import sys
+
+# IPython is not loaded by the lite interpreter
+ipython = sys.modules.get('IPython')
+shell = ipython.get_ipython() if ipython is not None else None
+if shell is not None and shell.history_manager.save_thread is not None:
+    shell.history_manager.save_thread.stop()
+    shell.history_manager.save_thread = None
+            )"), py::dict());
+        }
+
+        void after_fork_in_child(const client_context& context)
+        {
+            py::dict environment;
+            for (const auto& entry : context.m_environment)
+            {
+                std::size_t separator = entry.find('=');
+                environment[py::bytes(entry.substr(0, separator))] = py::bytes(entry.substr(separator + 1));
+            }
+            py::dict scope("cwd"_a=py::bytes(context.m_cwd), "environment"_a=environment);
+
+            exec(py::str(R"(
+import os
+import sys
+
+# The kernel runs in the directory and with the environment of its client,
+# os.environb updates the environment of the process as well
+try:
+    os.chdir(cwd)
+except OSError:
+    pass
+os.environb.clear()
+os.environb.update(environment)
+
+# The random module is reseeded by PyOS_AfterFork_Child
+if 'numpy.random' in sys.modules:
+    sys.modules['numpy.random'].seed()
+
+ipython = sys.modules.get('IPython')
+shell = ipython.get_ipython() if ipython is not None else None
+history_manager = shell.history_manager if shell is not None else None
+if history_manager is not None and history_manager.enabled and history_manager.hist_file != ':memory:':
+    from IPython.core.history import HistorySavingThread
+
+    history_manager.init_db()
+    history_manager.new_session()
+    history_manager.save_thread = HistorySavingThread(history_manager)
+    history_manager.save_thread.start()
+            )"), scope);
+        }
+
+        // The kernel exits when its client goes away
+        void watch_client(int client_fd)
+        {
+            std::thread([client_fd]()
+            {
+                char buffer[64];
+                while (true)
+                {
+                    ssize_t res = ::recv(client_fd, buffer, sizeof(buffer), 0);
+                    if (res == 0 || (res < 0 && errno != EINTR))
+                    {
+                        std::_Exit(0);
+                    }
+                }
+            }).detach();
+        }
+
+        volatile std::sig_atomic_t kernel_pid = 0;
+
+        void forward_signal(int sig)
+        {
+            if (kernel_pid > 0)
+            {
+                ::kill(static_cast<pid_t>(kernel_pid), sig);
+            }
+        }
+    }
+
+    std::string run_zygote(const std::string& socket_path,
+                           const std::vector<std::string>& preload_modules)
+    {
+        {
+            py::gil_scoped_acquire acquire;
+            for (const auto& module_name : preload_modules)
+            {
+                try
+                {
+                    py::module::import(module_name.c_str());
+                }
+                catch (std::exception& e)
+                {
+                    std::clog << "Could not preload " << module_name << ": " << e.what() << std::endl;
+                }
+            }
+            prepare_fork();
+        }
+
+        sockaddr_un address;
+        if (!make_address(socket_path, address))
+        {
+            return "";
+        }
+
+        int server_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ::unlink(socket_path.c_str());
+        // The socket is only accessible by the user running the zygote
+        mode_t mask = ::umask(0077);
+        bool bound = server_fd >= 0 && ::bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        ::umask(mask);
+        if (!bound
+            || ::chmod(socket_path.c_str(), S_IRUSR | S_IWUSR) < 0
+            || ::listen(server_fd, 16) < 0)
+        {
+            std::clog << "Could not listen on zygote socket " << socket_path
+                      << ": " << std::strerror(errno) << std::endl;
+            if (server_fd >= 0)
+            {
+                ::close(server_fd);
+            }
+            return "";
+        }
+
+        // Kernels are reaped automatically
+        std::signal(SIGCHLD, SIG_IGN);
+        std::clog << "xpython zygote listening on " << socket_path << std::endl;
+
+        while (true)
+        {
+            int client_fd = ::accept(server_fd, nullptr, nullptr);
+            if (client_fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                std::clog << "Zygote stopped: " << std::strerror(errno) << std::endl;
+                break;
+            }
+
+            if (!is_same_user(client_fd))
+            {
+                std::clog << "Zygote connection refused: the client is run by another user" << std::endl;
+                ::close(client_fd);
+                continue;
+            }
+
+            std::string connection_filename;
+            client_context context;
+            if (!read_line(client_fd, connection_filename) || connection_filename.empty()
+                || !read_context(client_fd, context))
+            {
+                ::close(client_fd);
+                continue;
+            }
+
+            pid_t pid;
+            {
+                py::gil_scoped_acquire acquire;
+                PyOS_BeforeFork();
+                pid = ::fork();
+                if (pid == 0)
+                {
+                    PyOS_AfterFork_Child();
+                    after_fork_in_child(context);
+                }
+                else
+                {
+                    PyOS_AfterFork_Parent();
+                }
+            }
+
+            if (pid == 0)
+            {
+                ::close(server_fd);
+                std::signal(SIGCHLD, SIG_DFL);
+                // Kept open until the kernel exits, but not by its subprocesses
+                ::fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+                watch_client(client_fd);
+                mark_startup_event("zygote_fork");
+                return connection_filename;
+            }
+
+            if (pid < 0)
+            {
+                std::clog << "Could not fork a kernel: " << std::strerror(errno) << std::endl;
+                write_line(client_fd, "error");
+            }
+            else
+            {
+                write_line(client_fd, std::to_string(pid));
+            }
+            ::close(client_fd);
+        }
+
+        ::close(server_fd);
+        ::unlink(socket_path.c_str());
+        return "";
+    }
+
+    int connect_zygote(const std::string& socket_path,
+                       const std::string& connection_filename)
+    {
+        sockaddr_un address;
+        if (!make_address(socket_path, address))
+        {
+            return 1;
+        }
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+        {
+            std::clog << "Could not connect to zygote " << socket_path
+                      << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+
+        write_line(fd, connection_filename);
+        if (!write_context(fd))
+        {
+            std::clog << "Could not send the working directory and the environment to the zygote" << std::endl;
+            ::close(fd);
+            return 1;
+        }
+        std::string answer;
+        if (!read_line(fd, answer) || answer == "error")
+        {
+            std::clog << "The zygote could not start the kernel" << std::endl;
+            ::close(fd);
+            return 1;
+        }
+
+        kernel_pid = static_cast<std::sig_atomic_t>(std::atoi(answer.c_str()));
+        std::signal(SIGINT, forward_signal);
+        std::signal(SIGTERM, forward_signal);
+        std::signal(SIGHUP, forward_signal);
+
+        // The connection is closed when the kernel exits
+        char buffer[64];
+        while (true)
+        {
+            ssize_t res = ::read(fd, buffer, sizeof(buffer));
+            if (res == 0 || (res < 0 && errno != EINTR))
+            {
+                break;
+            }
+        }
+        ::close(fd);
+        return 0;
+    }
+#else
+    std::string run_zygote(const std::string& /*socket_path*/,
+                           const std::vector<std::string>& /*preload_modules*/)
+    {
+        std::clog << "The zygote mode is not supported on Windows" << std::endl;
+        return "";
+    }
+
+    int connect_zygote(const std::string& /*socket_path*/,
+                       const std::string& /*connection_filename*/)
+    {
+        std::clog << "The zygote mode is not supported on Windows" << std::endl;
+        return 1;
+    }
+#endif
+}
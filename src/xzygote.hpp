@@ -0,0 +1,59 @@
+/***************************************************************************
+* Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and     *
+* Wolf Vollprecht                                                          *
+* Copyright (c) 2018, QuantStack                                           *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XPYT_ZYGOTE_HPP
+#define XPYT_ZYGOTE_HPP
+
+#include <string>
+#include <vector>
+
+namespace xpyt
+{
+    /**
+     * Zygote mode: the interpreter is configured once (IPython shell,
+     * extensions, preloaded modules), then a child is forked for each
+     * connection file received on the Unix domain socket. This function only
+     * returns in the forked children, with the connection file to start the
+     * kernel with, or in the zygote with an empty string upon error.
+     *
+     * The protocol is line based: the client sends the path of the connection
+     * file, its working directory and the size of its environment followed
+     * by the NUL-separated entries of the environment. The zygote answers
+     * with the pid of the kernel, which runs in the directory and with the
+     * environment of the client. The connection is inherited by the kernel,
+     * so that the client gets EOF when the kernel exits, and the kernel exits
+     * when the client goes away.
+     *
+     * The socket is only accessible by the user running the zygote, and
+     * connections from other users are refused (peer credentials).
+     *
+     * Must be called from the main thread, after the interpreter has been
+     * configured, and before any other thread is started. Not available on
+     * Windows.
+     */
+    std::string run_zygote(const std::string& socket_path,
+                           const std::vector<std::string>& preload_modules);
+
+    // Until the kernel of a forked child is created, the comm targets
+    // registered by the zygote (e.g. by the preloaded modules) are kept,
+    // the outputs are written to the terminal and the displays are dropped.
+    // attach_kernel() registers the comm targets, it must be called once the
+    // kernel is created and before it is started.
+    void detach_kernel();
+    void attach_kernel();
+
+    // Client side of the zygote protocol, stands for the kernel process:
+    // forwards SIGINT, SIGTERM and SIGHUP to the kernel and returns when
+    // the kernel exits.
+    int connect_zygote(const std::string& socket_path,
+                       const std::string& connection_filename);
+}
+
+#endif
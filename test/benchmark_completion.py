@@ -0,0 +1,143 @@
+#############################################################################
+# Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and      #
+# Wolf Vollprecht                                                           #
+# Copyright (c) 2018, QuantStack                                            #
+#                                                                           #
+# Distributed under the terms of the BSD 3-Clause License.                  #
+#                                                                           #
+# The full license is in the file LICENSE, distributed with this software.  #
+#############################################################################
+
+"""Measures the latency of the complete_request of the kernel.
+
+Usage: python benchmark_completion.py [-n REQUESTS] [--kernel-name xpython]
+                                      [--json] [--compare RESULTS.json]
+
+A kernel is started, a few objects are defined in its namespace, and REQUESTS
+complete_request messages are sent for each completion case. The round-trip
+latency is reported with its percentiles, along with the median time spent in
+the kernel (request_timings of the kernel). Results saved with --json from a
+previous build can be given to --compare to print the before and after numbers.
+"""
+
+import argparse
+import json
+import sys
+import time
+
+from jupyter_client.manager import KernelManager
+
+
+SETUP = '''
+import collections
+import os
+
+class Wide(object):
+    pass
+
+wide = Wide()
+for i in range(2000):
+    setattr(wide, 'attribute_%d' % i, i)
+
+long_variable_name = 1
+long_variable_other = 2
+'''
+
+CASES = [
+    ('name', 'long_var'),
+    ('module_attribute', 'os.pa'),
+    ('wide_object', 'wide.attr'),
+    ('import', 'import collec'),
+    ('dict_key', 'os.environ["PA'),
+]
+
+
+def percentile(values, q):
+    values = sorted(values)
+    index = (len(values) - 1) * q / 100.
+    lower = int(index)
+    upper = min(lower + 1, len(values) - 1)
+    return values[lower] + (values[upper] - values[lower]) * (index - lower)
+
+
+def summarize(values):
+    return {
+        'min': min(values),
+        'p50': percentile(values, 50),
+        'p90': percentile(values, 90),
+        'p99': percentile(values, 99),
+        'max': max(values),
+    }
+
+
+def run(kernel_name, requests, timeout):
+    km = KernelManager(kernel_name=kernel_name)
+    km.start_kernel(extra_arguments=['--XPythonShell.request_timings=True'])
+    kc = km.client()
+    kc.start_channels()
+    results = {}
+    try:
+        kc.wait_for_ready(timeout=timeout)
+        kc.execute_interactive(SETUP, timeout=timeout)
+        for name, code in CASES:
+            latencies = []
+            kernel_times = []
+            matches = 0
+            for _ in range(requests):
+                start = time.perf_counter()
+                msg_id = kc.complete(code, len(code))
+                reply = kc.get_shell_msg(timeout=timeout)
+                while reply['parent_header'].get('msg_id') != msg_id:
+                    reply = kc.get_shell_msg(timeout=timeout)
+                latencies.append(time.perf_counter() - start)
+                content = reply['content']
+                matches = len(content['matches'])
+                timings = content.get('metadata', {}).get('timings')
+                if timings:
+                    kernel_times.append(timings['total'])
+            results[name] = {
+                'code': code,
+                'matches': matches,
+                'latency': summarize(latencies),
+                'kernel': summarize(kernel_times) if kernel_times else None,
+            }
+    finally:
+        kc.stop_channels()
+        km.shutdown_kernel(now=True)
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('-n', '--requests', type=int, default=200)
+    parser.add_argument('--kernel-name', default='xpython')
+    parser.add_argument('--timeout', type=float, default=60.)
+    parser.add_argument('--json', action='store_true', help='print the results as JSON')
+    parser.add_argument('--compare', help='results of a previous run, saved with --json')
+    args = parser.parse_args()
+
+    results = run(args.kernel_name, args.requests, args.timeout)
+
+    if args.json:
+        json.dump(results, sys.stdout, indent=4)
+        print()
+        return
+
+    before = {}
+    if args.compare:
+        with open(args.compare) as f:
+            before = json.load(f)
+
+    print('Completion latency over %d requests per case (p50 / p90 in ms):' % args.requests)
+    for name, result in results.items():
+        line = '  %-18s %6.2f / %6.2f' % (name, result['latency']['p50'] * 1000, result['latency']['p90'] * 1000)
+        if result['kernel']:
+            line += '  (kernel %6.2f)' % (result['kernel']['p50'] * 1000)
+        if name in before:
+            previous = before[name]['latency']
+            line += '  before %6.2f / %6.2f' % (previous['p50'] * 1000, previous['p90'] * 1000)
+        print(line + '  %d matches' % result['matches'])
+
+
+if __name__ == '__main__':
+    main()
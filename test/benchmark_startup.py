@@ -0,0 +1,105 @@
+#############################################################################
+# Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and      #
+# Wolf Vollprecht                                                           #
+# Copyright (c) 2018, QuantStack                                            #
+#                                                                           #
+# Distributed under the terms of the BSD 3-Clause License.                  #
+#                                                                           #
+# The full license is in the file LICENSE, distributed with this software.  #
+#############################################################################
+
+"""Measures the time to the first kernel_info_reply of the kernel.
+
+Usage: python benchmark_startup.py [-n RUNS] [--kernel-name xpython] [--json]
+
+The kernel is started RUNS times, the time between the launch of the process
+and the reception of the first kernel_info_reply is reported with its
+percentiles. The startup report of each kernel (--startup-report option of
+xpython) is collected, and the median time of each startup event is reported.
+"""
+
+import argparse
+import json
+import os
+import statistics
+import sys
+import tempfile
+import time
+
+from jupyter_client.manager import KernelManager
+
+
+def percentile(values, q):
+    values = sorted(values)
+    index = (len(values) - 1) * q / 100.
+    lower = int(index)
+    upper = min(lower + 1, len(values) - 1)
+    return values[lower] + (values[upper] - values[lower]) * (index - lower)
+
+
+def run_once(kernel_name, report_path, timeout):
+    km = KernelManager(kernel_name=kernel_name)
+    start = time.perf_counter()
+    km.start_kernel(extra_arguments=['--startup-report', report_path])
+    kc = km.client()
+    kc.start_channels()
+    try:
+        kc.wait_for_ready(timeout=timeout)
+        elapsed = time.perf_counter() - start
+    finally:
+        kc.stop_channels()
+        km.shutdown_kernel(now=True)
+
+    report = None
+    if os.path.exists(report_path):
+        with open(report_path) as f:
+            report = json.load(f)
+        os.remove(report_path)
+    return elapsed, report
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('-n', '--runs', type=int, default=20)
+    parser.add_argument('--kernel-name', default='xpython')
+    parser.add_argument('--timeout', type=float, default=60.)
+    parser.add_argument('--json', action='store_true', help='print the results as JSON')
+    args = parser.parse_args()
+
+    report_path = os.path.join(tempfile.mkdtemp(), 'startup.json')
+    times = []
+    events = {}
+    for _ in range(args.runs):
+        elapsed, report = run_once(args.kernel_name, report_path, args.timeout)
+        times.append(elapsed)
+        for event in (report or {}).get('events', []):
+            events.setdefault(event['name'], []).append(event['time'])
+
+    results = {
+        'runs': args.runs,
+        'time_to_ready': {
+            'min': min(times),
+            'p50': percentile(times, 50),
+            'p90': percentile(times, 90),
+            'p99': percentile(times, 99),
+            'max': max(times),
+        },
+        'events': {name: statistics.median(values) for name, values in events.items()},
+    }
+
+    if args.json:
+        json.dump(results, sys.stdout, indent=4)
+        print()
+        return
+
+    print('Time to first kernel_info_reply over %d runs:' % args.runs)
+    for key, value in results['time_to_ready'].items():
+        print('  %-4s %8.1f ms' % (key, value * 1000))
+    if events:
+        print('Median time of the startup events:')
+        for name, value in sorted(results['events'].items(), key=lambda item: item[1]):
+            print('  %-28s %8.1f ms' % (name, value * 1000))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,147 @@
+#############################################################################
+# Copyright (c) 2018, Martin Renou, Johan Mabille, Sylvain Corlay, and      #
+# Wolf Vollprecht                                                           #
+# Copyright (c) 2018, QuantStack                                            #
+#                                                                           #
+# Distributed under the terms of the BSD 3-Clause License.                  #
+#                                                                           #
+# The full license is in the file LICENSE, distributed with this software.  #
+#############################################################################
+
+"""Measures the cost of the tracebacks of failing cells.
+
+Usage: python benchmark_traceback.py [-n REQUESTS] [--kernel-name xpython]
+                                     [--json] [--compare RESULTS.json]
+
+A kernel is started, a few recursive functions are defined in its namespace,
+and REQUESTS execute_request messages raising an exception at increasing
+recursion depths, or with a large error value, are sent for each case. The
+round-trip latency is reported with its percentiles, along with the median
+time spent formatting the traceback in the kernel (request_timings of the
+kernel). Results saved with --json from a previous build can be given to
+--compare to print the before and after numbers.
+"""
+
+import argparse
+import json
+import sys
+import time
+
+from jupyter_client.manager import KernelManager
+
+
+SETUP = '''
+def recurse(depth):
+    if depth == 0:
+        raise ValueError('bottom of the recursion')
+    return recurse(depth - 1)
+
+def ping(depth):
+    return pong(depth - 1) if depth else {}['missing']
+
+def pong(depth):
+    return ping(depth - 1) if depth else [][0]
+'''
+
+CASES = [
+    ('depth_1', 'recurse(1)'),
+    ('depth_100', 'recurse(100)'),
+    ('depth_900', 'recurse(900)'),
+    ('mutual_900', 'ping(900)'),
+    ('recursion_error', 'recurse(10 ** 6)'),
+    ('long_value', 'raise ValueError("x" * 10 ** 6)'),
+]
+
+
+def percentile(values, q):
+    values = sorted(values)
+    index = (len(values) - 1) * q / 100.
+    lower = int(index)
+    upper = min(lower + 1, len(values) - 1)
+    return values[lower] + (values[upper] - values[lower]) * (index - lower)
+
+
+def summarize(values):
+    return {
+        'min': min(values),
+        'p50': percentile(values, 50),
+        'p90': percentile(values, 90),
+        'p99': percentile(values, 99),
+        'max': max(values),
+    }
+
+
+def run(kernel_name, requests, timeout):
+    km = KernelManager(kernel_name=kernel_name)
+    km.start_kernel(extra_arguments=['--XPythonShell.request_timings=True'])
+    kc = km.client()
+    kc.start_channels()
+    results = {}
+    try:
+        kc.wait_for_ready(timeout=timeout)
+        kc.execute_interactive(SETUP, timeout=timeout)
+        for name, code in CASES:
+            latencies = []
+            kernel_times = []
+            frames = 0
+            size = 0
+            for _ in range(requests):
+                start = time.perf_counter()
+                msg_id = kc.execute(code, store_history=False)
+                reply = kc.get_shell_msg(timeout=timeout)
+                while reply['parent_header'].get('msg_id') != msg_id:
+                    reply = kc.get_shell_msg(timeout=timeout)
+                latencies.append(time.perf_counter() - start)
+                content = reply['content']
+                frames = len(content.get('traceback', []))
+                size = sum(len(frame) for frame in content.get('traceback', []))
+                timings = content.get('metadata', {}).get('timings')
+                if timings and 'traceback' in timings:
+                    kernel_times.append(timings['traceback'])
+            results[name] = {
+                'code': code,
+                'frames': frames,
+                'bytes': size,
+                'latency': summarize(latencies),
+                'kernel': summarize(kernel_times) if kernel_times else None,
+            }
+    finally:
+        kc.stop_channels()
+        km.shutdown_kernel(now=True)
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('-n', '--requests', type=int, default=20)
+    parser.add_argument('--kernel-name', default='xpython')
+    parser.add_argument('--timeout', type=float, default=60.)
+    parser.add_argument('--json', action='store_true', help='print the results as JSON')
+    parser.add_argument('--compare', help='results of a previous run, saved with --json')
+    args = parser.parse_args()
+
+    results = run(args.kernel_name, args.requests, args.timeout)
+
+    if args.json:
+        json.dump(results, sys.stdout, indent=4)
+        print()
+        return
+
+    before = {}
+    if args.compare:
+        with open(args.compare) as f:
+            before = json.load(f)
+
+    print('Failing cell latency over %d requests per case (p50 / p90 in ms):' % args.requests)
+    for name, result in results.items():
+        line = '  %-18s %7.2f / %7.2f' % (name, result['latency']['p50'] * 1000, result['latency']['p90'] * 1000)
+        if result['kernel']:
+            line += '  (traceback %7.2f)' % (result['kernel']['p50'] * 1000)
+        if name in before:
+            previous = before[name]['latency']
+            line += '  before %7.2f / %7.2f' % (previous['p50'] * 1000, previous['p90'] * 1000)
+        print(line + '  %d frames, %d bytes' % (result['frames'], result['bytes']))
+
+
+if __name__ == '__main__':
+    main()
@@ -8,10 +8,17 @@
 # The full license is in the file LICENSE, distributed with this software.  #
 #############################################################################
 
+import os
+import shutil
+import subprocess
+import sys
 import tempfile
+import time
 import unittest
 import jupyter_kernel_test
 
+from jupyter_client.manager import KernelManager
+
 
 class XeusPythonTests(jupyter_kernel_test.KernelTests):
 
@@ -34,10 +41,254 @@ class XeusPythonTests(jupyter_kernel_test.KernelTests):
 
     code_inspect_sample = "open"
 
+    def set_shell_option(self, option, value, default):
+        # The default value is restored even when the test fails, so that
+        # the option does not leak into the next tests
+        self.execute_helper(code='get_ipython().%s = %r' % (option, value))
+        self.addCleanup(self.execute_helper, code='get_ipython().%s = %r' % (option, default))
+
     def test_xeus_python_history_manager(self):
         reply, output_msgs = self.execute_helper(code="assert get_ipython().history_manager is not None")
         self.assertEqual(reply['content']['status'], 'ok')
 
+    def test_xeus_python_input_transformation(self):
+        reply, output_msgs = self.execute_helper(code="a = 6 * 7\nassert a % 5 == 2")
+        self.assertEqual(reply['content']['status'], 'ok')
+        reply, output_msgs = self.execute_helper(code="b = %pwd\nassert b is not None")
+        self.assertEqual(reply['content']['status'], 'ok')
+
+        # Transformers registered by the user still apply to plain Python cells
+        self.execute_helper(code="get_ipython().input_transformers_cleanup.append("
+                                 "lambda lines: [line.replace('transformed_value', '42') for line in lines])")
+        try:
+            reply, output_msgs = self.execute_helper(code="assert transformed_value == 42")
+            self.assertEqual(reply['content']['status'], 'ok')
+        finally:
+            self.execute_helper(code="get_ipython().input_transformers_cleanup.pop()")
+
+    def test_xeus_python_request_timings(self):
+        self.set_shell_option('request_timings', True, False)
+        reply, output_msgs = self.execute_helper(code="a = 3")
+        timings = reply['content']['metadata']['timings']
+        self.assertIn('run_cell', timings)
+        self.assertGreaterEqual(timings['total'], timings['run_cell'])
+
+    def test_xeus_python_interrupt(self):
+        # Busy loop, and blocking system call
+        for code in ('while True: pass', 'import time; time.sleep(60)'):
+            self.flush_channels()
+            msg_id = self.kc.execute(code=code)
+            time.sleep(0.5)
+
+            start = time.perf_counter()
+            self.km.interrupt_kernel()
+            reply = self.kc.get_shell_msg(timeout=10)
+            latency = time.perf_counter() - start
+
+            self.assertEqual(reply['parent_header']['msg_id'], msg_id)
+            self.assertEqual(reply['content']['status'], 'error')
+            self.assertEqual(reply['content']['ename'], 'KeyboardInterrupt')
+            # A few milliseconds locally, the bound leaves room for slow CI machines
+            self.assertLess(latency, 0.5, code)
+            self.flush_channels()
+
+        # Interrupting an idle kernel has no effect on the next cell
+        self.km.interrupt_kernel()
+        time.sleep(0.5)
+        reply, output_msgs = self.execute_helper(code='a = 1')
+        self.assertEqual(reply['content']['status'], 'ok')
+
+    def test_xeus_python_wall_time_limit(self):
+        self.flush_channels()
+        self.set_shell_option('cell_wall_time_limit', 0.5, 0)
+        reply, output_msgs = self.execute_helper(code='while True: pass', timeout=10)
+        self.assertEqual(reply['content']['status'], 'error')
+        self.assertEqual(reply['content']['ename'], 'KernelResourceError')
+        self.assertEqual(reply['content']['resource_limit']['resource'], 'wall_time')
+
+        self.execute_helper(code='get_ipython().cell_wall_time_limit = 0')
+        reply, output_msgs = self.execute_helper(code='a = 1')
+        self.assertEqual(reply['content']['status'], 'ok')
+
+        # The exception can be imported and pickled, the limits are validated
+        reply, output_msgs = self.execute_helper(code='import pickle\n'
+                                                      'from xpython_resources import KernelResourceError\n'
+                                                      'error = pickle.loads(pickle.dumps(KernelResourceError("x")))\n'
+                                                      'assert isinstance(error, KernelResourceError)')
+        self.assertEqual(reply['content']['status'], 'ok')
+        reply, output_msgs = self.execute_helper(code='get_ipython().cell_memory_limit = -1')
+        self.assertEqual(reply['content']['status'], 'error')
+        self.assertEqual(reply['content']['ename'], 'TraitError')
+
+    def test_xeus_python_memory_profiling(self):
+        self.flush_channels()
+        self.execute_helper(code='%xmem on')
+        self.addCleanup(self.execute_helper, code='%xmem off')
+        reply, output_msgs = self.execute_helper(code='a = [0] * 1000000')
+        memory = reply['content']['metadata']['memory']
+        self.assertGreater(memory['traced_delta'], 1000000)
+        self.assertGreater(memory['top'][0]['size_diff'], 1000000)
+
+        reply, output_msgs = self.execute_helper(code='%xmem off')
+        self.assertIn('memory', reply['content']['metadata'])
+        reply, output_msgs = self.execute_helper(code='del a')
+        self.assertNotIn('memory', reply['content'].get('metadata', {}))
+
+    def test_xeus_python_reclaim_memory(self):
+        self.flush_channels()
+        self.set_shell_option('reclaim_memory', True, False)
+        self.set_shell_option('malloc_trim_threshold', 0, 64 * 1024 * 1024)
+        for _ in range(3):
+            reply, output_msgs = self.execute_helper(code='reclaimed = [str(i) for i in range(100000)]\ndel reclaimed')
+            self.assertEqual(reply['content']['status'], 'ok')
+            # Lets the delayed collection run between two cells
+            time.sleep(0.2)
+        reply, output_msgs = self.execute_helper(code='print(len([0] * 1000))')
+        self.assertEqual(output_msgs[0]['content']['text'], '1000')
+
+    def test_xeus_python_output_history(self):
+        self.flush_channels()
+        self.set_shell_option('displayhook.max_outputs', 2, 0)
+        counts = []
+        for i in range(4):
+            reply, output_msgs = self.execute_helper(code='[%d]' % i)
+            counts.append(reply['content']['execution_count'])
+        reply, output_msgs = self.execute_helper(code='print(sorted(dict.keys(Out)) == %r)' % counts[-2:])
+        self.assertEqual(output_msgs[0]['content']['text'], 'True')
+
+    def test_xeus_python_output_spill(self):
+        self.flush_channels()
+        spill_dir = tempfile.mkdtemp()
+        self.addCleanup(shutil.rmtree, spill_dir, True)
+        self.set_shell_option('displayhook.max_outputs', 1, 0)
+        self.set_shell_option('displayhook.output_spill_dir', spill_dir, '')
+
+        reply, output_msgs = self.execute_helper(code='[10, 20]')
+        spilled = reply['content']['execution_count']
+        self.execute_helper(code='[30]')
+        self.assertEqual(len(os.listdir(spill_dir)), 1)
+
+        # The evicted output is reloaded from the disk when accessed
+        reply, output_msgs = self.execute_helper(code='print(%d in dict.keys(Out), Out[%d] == [10, 20])' % (spilled, spilled))
+        self.assertEqual(output_msgs[0]['content']['text'], 'False True')
+
+    def test_xeus_python_completion_cache(self):
+        self.flush_channels()
+        self.execute_helper(code='cached_variable_one = 1\ncached_variable_two = 2')
+        self.kc.complete('cached_var', 10)
+        reply = self.get_non_kernel_info_reply()
+        self.assertEqual(sorted(reply['content']['matches']), ['cached_variable_one', 'cached_variable_two'])
+        self.kc.complete('cached_variable_o', 17)
+        reply = self.get_non_kernel_info_reply()
+        self.assertEqual(reply['content']['matches'], ['cached_variable_one'])
+        self.assertEqual(reply['content']['cursor_start'], 0)
+
+        # Executions invalidate the cache
+        self.execute_helper(code='cached_variable_other = 3')
+        self.kc.complete('cached_variable_o', 17)
+        reply = self.get_non_kernel_info_reply()
+        self.assertEqual(sorted(reply['content']['matches']), ['cached_variable_one', 'cached_variable_other'])
+
+        # Magics are narrowed without their escape
+        self.kc.complete('se', 2)
+        self.get_non_kernel_info_reply()
+        self.kc.complete('set_e', 5)
+        reply = self.get_non_kernel_info_reply()
+        self.assertIn('%set_env', reply['content']['matches'])
+
+    def test_xeus_python_native_completion(self):
+        self.flush_channels()
+        self.execute_helper(code='import os\nnative_name_one = 1\nnative_name_two = 2')
+        self.kc.complete('x = native_na', 13)
+        reply = self.get_non_kernel_info_reply()
+        self.assertEqual(reply['content']['matches'], ['native_name_one', 'native_name_two'])
+        self.assertEqual(reply['content']['cursor_start'], 4)
+
+        self.kc.complete('os.pa', 5)
+        reply = self.get_non_kernel_info_reply()
+        expected = sorted((name for name in dir(os) if name.startswith('pa')), key=str.lower)
+        self.assertEqual(reply['content']['matches'], expected)
+        self.assertEqual(reply['content']['cursor_start'], 3)
+
+        self.execute_helper(code='del native_name_two')
+        self.kc.complete('native_na', 9)
+        reply = self.get_non_kernel_info_reply()
+        self.assertEqual(reply['content']['matches'], ['native_name_one'])
+
+        # Names of the cell that are not in the namespace are left to jedi
+        samples = [
+            ('def f(native_parameter):\n    return native_pa', 'native_parameter'),
+            ('native_local = 1\nnative_lo', 'native_local'),
+        ]
+        for code, expected in samples:
+            self.kc.complete(code, len(code))
+            reply = self.get_non_kernel_info_reply()
+            self.assertIn(expected, reply['content']['matches'])
+
+    def test_xeus_python_module_completion(self):
+        # Answered by IPython until the index of the modules is built
+        self.flush_channels()
+        for code in ('import collecti', 'from collecti'):
+            self.kc.complete(code, len(code))
+            reply = self.get_non_kernel_info_reply()
+            self.assertIn('collections', reply['content']['matches'])
+            self.assertEqual(reply['content']['cursor_start'], len(code) - 7)
+
+    def test_xeus_python_native_is_complete(self):
+        self.flush_channels()
+        samples = [
+            ('x = (1,\n  2', 'incomplete', '  '),
+            ('s = """abc', 'incomplete', ''),
+            ('a = 1 + \\', 'incomplete', ''),
+            ('for i in range(3):\n    if i:', 'incomplete', '        '),
+            ('if x:\n    pass', 'incomplete', '    '),
+            ('if x:\n    pass\n', 'complete', None),
+            ('x = 1 is 1', 'invalid', None),
+            ('return', 'invalid', None),
+            ('a = 1)', 'invalid', None),
+        ]
+        for code, status, indent in samples:
+            self.kc.is_complete(code)
+            reply = self.get_non_kernel_info_reply()
+            self.assertEqual(reply['content']['status'], status, code)
+            if indent is not None:
+                self.assertEqual(reply['content']['indent'], indent, code)
+
+    def test_xeus_python_inspect_cache(self):
+        self.flush_channels()
+        self.execute_helper(code='def inspected():\n    """first docstring"""')
+        self.kc.inspect('inspected', 9, 0)
+        first = self.get_non_kernel_info_reply()
+        self.kc.inspect('inspected', 9, 0)
+        second = self.get_non_kernel_info_reply()
+        self.assertEqual(first['content']['data'], second['content']['data'])
+        self.assertIn('first docstring', second['content']['data']['text/plain'])
+
+        # Rebinding the name invalidates the cached reply
+        self.execute_helper(code='def inspected():\n    """second docstring"""')
+        self.kc.inspect('inspected', 9, 0)
+        reply = self.get_non_kernel_info_reply()
+        self.assertIn('second docstring', reply['content']['data']['text/plain'])
+
+    def test_xeus_python_completion_time_budget(self):
+        self.flush_channels()
+        self.execute_helper(code=(
+            'import time\n'
+            'class SlowDir(object):\n'
+            '    def __dir__(self):\n'
+            '        end = time.time() + 3\n'
+            '        while time.time() < end: pass\n'
+            '        return ["attribute"]\n'
+            'slow_dir = SlowDir()'
+        ))
+        self.set_shell_option('completion_time_budget', 0.2, 0)
+        start = time.time()
+        self.kc.complete('slow_dir.', 9)
+        reply = self.get_non_kernel_info_reply(timeout=10)
+        self.assertLess(time.time() - start, 3)
+        self.assertTrue(reply['content']['metadata']['partial'])
+        self.assertIn(reply['content']['metadata']['slow_source'], ['jedi', 'ipython'])
+
     def test_xeus_python_stdout(self):
         reply, output_msgs = self.execute_helper(code='print(3)')
         self.assertEqual(output_msgs[0]['msg_type'], 'stream')
@@ -62,5 +313,187 @@ class XeusPythonTests(jupyter_kernel_test.KernelTests):
             traceback[3]
         )
 
+    def test_xeus_python_traceback_frames(self):
+        self.flush_channels()
+        self.execute_helper(code='import json\ndef parse(text):\n    return json.loads(text)')
+        reply, output_msgs = self.execute_helper(code='parse("{")')
+        traceback = output_msgs[0]['content']['traceback']
+        self.assertIn('parse(', traceback[1])
+        self.assertIn('json.loads(text)', traceback[2])
+        self.assertIn('Line \u001b[0;34m3\u001b[0m', traceback[2])
+        self.assertTrue(any('decoder.py' in frame and 'raw_decode' in frame for frame in traceback[3:-1]))
+
+    def test_xeus_python_traceback_modified_source(self):
+        self.flush_channels()
+        module_dir = tempfile.mkdtemp()
+        self.addCleanup(shutil.rmtree, module_dir, True)
+        path = os.path.join(module_dir, 'edited_module.py')
+        self.execute_helper(code='import sys\nsys.path.insert(0, %r)' % module_dir)
+        self.addCleanup(self.execute_helper, code='sys.path.remove(%r)' % module_dir)
+
+        # The traceback shows the lines of the module as edited by the user
+        for version in ('first', 'second version'):
+            with open(path, 'w') as f:
+                f.write('def fail():\n    raise ValueError(%r)\n' % version)
+            reply, output_msgs = self.execute_helper(code='import importlib, edited_module\n'
+                                                          'importlib.reload(edited_module)\n'
+                                                          'edited_module.fail()')
+            traceback = reply['content']['traceback']
+            self.assertIn('edited_module.py', traceback[-2])
+            self.assertIn(version, traceback[-2])
+
+    def test_xeus_python_traceback_limits(self):
+        self.flush_channels()
+        self.execute_helper(code='def recurse(n):\n    return recurse(n + 1)')
+        reply, output_msgs = self.execute_helper(code='recurse(0)')
+        traceback = reply['content']['traceback']
+        self.assertEqual(reply['content']['ename'], 'RecursionError')
+        self.assertLessEqual(len(traceback), 5)
+        self.assertTrue(traceback[-2].startswith('[Previous frame repeated '))
+
+        self.set_shell_option('traceback_max_line_length', 100, 1000)
+        reply, output_msgs = self.execute_helper(code='raise ValueError("x" * 5000)')
+        self.assertEqual(reply['content']['evalue'], 'x' * 100 + '...')
+
+class XeusPythonLiteTests(jupyter_kernel_test.KernelTests):
+
+    kernel_name = "xpython"
+    language_name = "python"
+
+    code_hello_world = "print('hello, world')"
+
+    code_execute_result = [{'code': '6 * 7', 'result': '42'}]
+
+    code_generate_error = "raise ValueError('lite error')"
+
+    completion_samples = [
+        {'text': 'pri', 'matches': {'print'}},
+    ]
+
+    complete_code_samples = ['1', "print('hello, world')", "def f(x):\n  return x*2\n\n\n"]
+    incomplete_code_samples = ["print('''hello", "def f(x):\n  x*2"]
+    invalid_code_samples = ['import = 7q']
+
+    code_inspect_sample = "open"
+
+    @classmethod
+    def setUpClass(cls):
+        cls.km = KernelManager(kernel_name=cls.kernel_name)
+        argv = cls.km.kernel_spec.argv
+        cls.km.kernel_spec.argv = argv[:1] + ['--lite'] + argv[1:]
+        cls.km.start_kernel()
+        cls.kc = cls.km.client()
+        cls.kc.start_channels()
+        cls.kc.wait_for_ready(timeout=60)
+
+    def test_xeus_python_lite_no_ipython(self):
+        reply, output_msgs = self.execute_helper(code="import sys\nprint('IPython' in sys.modules)")
+        self.assertEqual(output_msgs[0]['content']['text'], 'False')
+
+    def test_xeus_python_lite_rich_result(self):
+        # The lite shell has no display function, rich representations are
+        # published by its native display hook
+        self.flush_channels()
+        reply, output_msgs = self.execute_helper(code=(
+            'class Rich(object):\n'
+            '    def _repr_html_(self):\n'
+            '        return "<b>rich</b>"\n'
+            'Rich()'
+        ))
+        self.assertEqual(output_msgs[0]['msg_type'], 'execute_result')
+        self.assertEqual(output_msgs[0]['content']['data']['text/html'], '<b>rich</b>')
+        self.assertIn('text/plain', output_msgs[0]['content']['data'])
+
+    def test_xeus_python_lite_traceback(self):
+        self.flush_channels()
+        self.execute_helper(code='def lite_failing():\n    return 1 / 0')
+        reply, output_msgs = self.execute_helper(code='lite_failing()')
+        self.assertEqual(reply['content']['status'], 'error')
+        self.assertEqual(reply['content']['ename'], 'ZeroDivisionError')
+        traceback = output_msgs[0]['content']['traceback']
+        self.assertIn('lite_failing()', traceback[1])
+        self.assertIn('return 1 / 0', traceback[2])
+
+    def test_xeus_python_lite_completion(self):
+        self.flush_channels()
+        self.execute_helper(code='lite_name_one = 1\nlite_name_two = 2\nimport os')
+        self.kc.complete('x = lite_na', 11)
+        reply = self.get_non_kernel_info_reply()
+        self.assertEqual(sorted(reply['content']['matches']), ['lite_name_one', 'lite_name_two'])
+        self.assertEqual(reply['content']['cursor_start'], 4)
+        self.kc.complete('os.pa', 5)
+        reply = self.get_non_kernel_info_reply()
+        self.assertIn('os.path', reply['content']['matches'])
+        self.assertEqual(reply['content']['cursor_start'], 0)
+
+
+PRELOADED_MODULE = '''
+import builtins
+from IPython import get_ipython
+
+print('imported by the zygote')
+
+def open_target(comm, msg):
+    builtins.zygote_comm_opened = True
+
+get_ipython().kernel.comm_manager.register_target('zygote_target', open_target)
+'''
+
+
+@unittest.skipIf(sys.platform.startswith('win'), 'The zygote mode is not available on Windows')
+class XeusPythonZygoteTests(unittest.TestCase):
+
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        with open(os.path.join(self.tmpdir, 'zygote_preloaded.py'), 'w') as f:
+            f.write(PRELOADED_MODULE)
+
+        self.km = KernelManager(kernel_name='xpython')
+        executable = self.km.kernel_spec.argv[0]
+        socket_path = os.path.join(self.tmpdir, 'zygote.sock')
+        env = dict(os.environ, PYTHONPATH=self.tmpdir)
+        self.zygote = subprocess.Popen([executable, '--zygote', socket_path, '--zygote-preload', 'zygote_preloaded'], env=env)
+        deadline = time.time() + 60
+        while not os.path.exists(socket_path):
+            self.assertIsNone(self.zygote.poll(), 'the zygote exited')
+            self.assertLess(time.time(), deadline, 'the zygote did not create its socket')
+            time.sleep(0.1)
+        time.sleep(0.1)
+
+        self.km.kernel_spec.argv = [executable, '--zygote-connect', socket_path, '-f', '{connection_file}']
+
+    def tearDown(self):
+        self.zygote.terminate()
+        self.zygote.wait(timeout=10)
+        shutil.rmtree(self.tmpdir)
+
+    def test_xeus_python_zygote_kernel(self):
+        self.km.start_kernel(env=dict(os.environ, XPYTHON_ZYGOTE_TEST='forwarded'))
+        kc = self.km.client()
+        kc.start_channels()
+        try:
+            kc.wait_for_ready(timeout=60)
+
+            # The comm target registered by the preloaded module is available in the forked kernel
+            kc.shell_channel.send(kc.session.msg('comm_open', {
+                'comm_id': 'zygote_comm', 'target_name': 'zygote_target', 'data': {}
+            }))
+
+            outputs = []
+            reply = kc.execute_interactive(
+                "import os\nprint(os.environ['XPYTHON_ZYGOTE_TEST'], os.getpid(), zygote_comm_opened)",
+                timeout=30, output_hook=outputs.append
+            )
+            self.assertEqual(reply['content']['status'], 'ok')
+            text = ''.join(msg['content']['text'] for msg in outputs if msg['msg_type'] == 'stream')
+            value, pid, opened = text.split()
+            self.assertEqual(value, 'forwarded')
+            self.assertNotEqual(int(pid), self.zygote.pid)
+            self.assertEqual(opened, 'True')
+        finally:
+            kc.stop_channels()
+            self.km.shutdown_kernel(now=True)
+
+
 if __name__ == '__main__':
     unittest.main()